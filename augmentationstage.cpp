@@ -0,0 +1,194 @@
+#include "augmentationstage.h"
+#include <cmath>
+
+namespace {
+
+// SplitMix64 step; cheap and good enough to pick transform parameters
+quint64 nextRandom(quint64& state)
+{
+    quint64 z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform float in [0, 1)
+float nextUniform(quint64& state)
+{
+    return static_cast<float>(nextRandom(state) >> 40) * (1.0f / 16777216.0f);
+}
+
+} // namespace
+
+AugmentationStage::AugmentationStage(const DatasetStore& dataset, const AugmentationOptions& options,
+                                     quint64 seed, int threadCount)
+    : dataset(dataset), options(options), seed(seed), order(nullptr), epoch(0), epochSize(0),
+      nextClaim(0), consumed(0), released(0), busy(0), stopping(false)
+{
+    if (threadCount <= 0) {
+        threadCount = qMax(1, QThread::idealThreadCount() - 1);
+    }
+
+    // Two buffers per worker keep every worker busy while the trainer holds one
+    ring.resize(threadCount * 2);
+
+    for (int i = 0; i < threadCount; ++i) {
+        QThread* thread = QThread::create([this]() { workerLoop(); });
+        threads.append(thread);
+        thread->start();
+    }
+}
+
+AugmentationStage::~AugmentationStage()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        canProduce.wakeAll();
+    }
+
+    for (QThread* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void AugmentationStage::startEpoch(const std::vector<int>& order, int epoch)
+{
+    QMutexLocker locker(&mutex);
+
+    // Let any worker still writing a slot finish before the ring is reset
+    while (busy > 0) {
+        slotReady.wait(&mutex);
+    }
+
+    this->order = &order;
+    this->epoch = epoch;
+    epochSize = static_cast<qint64>(order.size());
+    nextClaim = 0;
+    consumed = 0;
+    released = 0;
+    for (Slot& slot : ring) {
+        slot.sequence = -1;
+    }
+
+    canProduce.wakeAll();
+}
+
+const Eigen::VectorXf& AugmentationStage::next()
+{
+    QMutexLocker locker(&mutex);
+
+    // The buffer returned by the previous call is no longer in use
+    released = consumed;
+    canProduce.wakeAll();
+
+    Slot& slot = ring[consumed % static_cast<qint64>(ring.size())];
+    while (slot.sequence != consumed) {
+        slotReady.wait(&mutex);
+    }
+
+    ++consumed;
+    return slot.input;
+}
+
+void AugmentationStage::workerLoop()
+{
+    const qint64 slotCount = static_cast<qint64>(ring.size());
+
+    QMutexLocker locker(&mutex);
+    while (true) {
+        while (!stopping && (nextClaim >= epochSize || nextClaim >= released + slotCount)) {
+            canProduce.wait(&mutex);
+        }
+        if (stopping) {
+            return;
+        }
+
+        const qint64 sequence = nextClaim++;
+        const int sampleIndex = (*order)[sequence];
+        const int sampleEpoch = epoch;
+        Slot& slot = ring[sequence % slotCount];
+        ++busy;
+
+        locker.unlock();
+        augment(dataset.sampleData(sampleIndex), dataset.getSampleWidth(), dataset.getSampleHeight(),
+                options, seed, sampleEpoch, sampleIndex, slot.input);
+        locker.relock();
+
+        slot.sequence = sequence;
+        --busy;
+        slotReady.wakeAll();
+    }
+}
+
+void AugmentationStage::augment(const uchar* source, int width, int height, const AugmentationOptions& options,
+                                quint64 seed, int epoch, int sampleIndex, Eigen::VectorXf& input)
+{
+    // Draw the transform for this (seed, epoch, sample) triple
+    quint64 state = seed ^ (static_cast<quint64>(epoch) << 32) ^ static_cast<quint32>(sampleIndex);
+    nextRandom(state);
+
+    const bool flipH = options.flipHorizontal && (nextRandom(state) & 1);
+    const bool flipV = options.flipVertical && (nextRandom(state) & 1);
+    const float angle = (nextUniform(state) * 2.0f - 1.0f) * options.maxRotation * (3.14159265f / 180.0f);
+    const int span = 2 * qMax(0, options.maxTranslation) + 1;
+    const int tx = static_cast<int>(nextRandom(state) % span) - qMax(0, options.maxTranslation);
+    const int ty = static_cast<int>(nextRandom(state) % span) - qMax(0, options.maxTranslation);
+
+    input.setZero(static_cast<Eigen::Index>(width) * height);
+
+    typedef Eigen::Map<const Eigen::Matrix<uchar, Eigen::Dynamic, 1>> ByteRow;
+
+    if (angle == 0.0f) {
+        // Pure shift and flips: every output row is a shifted source row,
+        // converted with vectorized Eigen expressions
+        const int x0 = qMax(0, tx);
+        const int x1 = qMin(width, width + tx);
+        for (int y = 0; y < height; ++y) {
+            const int sy = (flipV ? height - 1 - y : y) - ty;
+            if (sy < 0 || sy >= height || x1 <= x0) {
+                continue;
+            }
+
+            auto row = input.segment(static_cast<Eigen::Index>(y) * width, width);
+            row.segment(x0, x1 - x0) = ByteRow(source + static_cast<size_t>(sy) * width + (x0 - tx), x1 - x0)
+                                           .cast<float>() / 255.0f;
+            if (flipH) {
+                row.reverseInPlace();
+            }
+        }
+        return;
+    }
+
+    // Rotation about the centre: map each output pixel back to its source
+    // pixel. Coordinates are computed a row at a time with Eigen arrays; the
+    // nearest-neighbour gather itself is scalar.
+    const float cx = (width - 1) * 0.5f;
+    const float cy = (height - 1) * 0.5f;
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+
+    Eigen::ArrayXf dx = Eigen::ArrayXf::LinSpaced(width, 0.0f, static_cast<float>(width - 1));
+    if (flipH) {
+        dx.reverseInPlace();
+    }
+    dx -= static_cast<float>(tx) + cx;
+
+    Eigen::ArrayXf sx(width);
+    Eigen::ArrayXf sy(width);
+    for (int y = 0; y < height; ++y) {
+        const float dy = static_cast<float>(flipV ? height - 1 - y : y) - ty - cy;
+        sx = (c * dx + (s * dy + cx + 0.5f)).floor();
+        sy = ((-s) * dx + (c * dy + cy + 0.5f)).floor();
+
+        float* out = input.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            const int ix = static_cast<int>(sx(x));
+            const int iy = static_cast<int>(sy(x));
+            if (ix >= 0 && ix < width && iy >= 0 && iy < height) {
+                out[x] = static_cast<float>(source[static_cast<size_t>(iy) * width + ix]) / 255.0f;
+            }
+        }
+    }
+}
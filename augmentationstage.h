@@ -0,0 +1,118 @@
+#ifndef AUGMENTATIONSTAGE_H
+#define AUGMENTATIONSTAGE_H
+
+#include "datasetstore.h"
+#include </usr/local/include/Eigen/Dense>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QList>
+#include <vector>
+
+/**
+ * @brief Random transforms applied to training samples
+ */
+struct AugmentationOptions
+{
+    bool enabled = false;           ///< Whether to augment at all
+    bool flipHorizontal = true;     ///< Mirror left-right with probability 1/2
+    bool flipVertical = false;      ///< Mirror top-bottom with probability 1/2
+    float maxRotation = 10.0f;      ///< Largest rotation in degrees, either direction
+    int maxTranslation = 16;        ///< Largest shift in pixels along each axis
+};
+
+/**
+ * @brief The AugmentationStage class produces augmented training inputs on worker threads
+ *
+ * The stage sits between the DatasetStore and MLP::train. Worker threads
+ * transform the samples of the current epoch, in visiting order, into a
+ * small ring of input buffers while the training thread consumes them, so
+ * augmentation overlaps with training and no augmented copy of the dataset
+ * is ever materialized.
+ *
+ * The transform applied to a sample depends only on the seed, the epoch and
+ * the sample index, so results do not depend on thread scheduling.
+ */
+class AugmentationStage
+{
+public:
+    /**
+     * @brief AugmentationStage constructor
+     * @param dataset Samples to augment; must outlive the stage
+     * @param options Transforms to apply
+     * @param seed Augmentation seed of the run
+     * @param threadCount Number of worker threads, or 0 for the ideal thread count
+     */
+    AugmentationStage(const DatasetStore& dataset, const AugmentationOptions& options,
+                      quint64 seed, int threadCount = 0);
+
+    /**
+     * @brief Stop the worker threads
+     */
+    ~AugmentationStage();
+
+    /**
+     * @brief Start producing the samples of an epoch
+     *
+     * The previous epoch must have been consumed completely.
+     *
+     * @param order Visiting order of the epoch; must stay valid until it has been consumed
+     * @param epoch Zero-based epoch number
+     */
+    void startEpoch(const std::vector<int>& order, int epoch);
+
+    /**
+     * @brief Get the next augmented input in visiting order
+     *
+     * Blocks until the input is ready. The returned buffer stays valid until
+     * the next call.
+     *
+     * @return Normalized network input
+     */
+    const Eigen::VectorXf& next();
+
+    /**
+     * @brief Apply the transform chosen for one sample
+     * @param source Grayscale record of width x height bytes
+     * @param width Sample width in pixels
+     * @param height Sample height in pixels
+     * @param options Transforms to apply
+     * @param seed Augmentation seed of the run
+     * @param epoch Zero-based epoch number
+     * @param sampleIndex Index of the sample in the dataset
+     * @param input Output vector, resized to width x height
+     */
+    static void augment(const uchar* source, int width, int height, const AugmentationOptions& options,
+                        quint64 seed, int epoch, int sampleIndex, Eigen::VectorXf& input);
+
+private:
+    struct Slot
+    {
+        Eigen::VectorXf input;
+        qint64 sequence = -1;
+    };
+
+    const DatasetStore& dataset;
+    AugmentationOptions options;
+    quint64 seed;
+
+    QList<QThread*> threads;
+    std::vector<Slot> ring;
+
+    QMutex mutex;
+    QWaitCondition slotReady;
+    QWaitCondition canProduce;
+
+    const std::vector<int>* order;
+    int epoch;
+    qint64 epochSize;
+    qint64 nextClaim;   // next position handed to a worker
+    qint64 consumed;    // positions returned by next()
+    qint64 released;    // positions whose slots may be overwritten
+    int busy;           // workers currently transforming
+    bool stopping;
+
+    void workerLoop();
+};
+
+#endif // AUGMENTATIONSTAGE_H
@@ -0,0 +1,95 @@
+#include "cascade.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QDebug>
+
+bool CascadeFile::read(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open cascade file" << filePath << file.errorString();
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll(), &error).object();
+    if (error.error != QJsonParseError::NoError || !json.contains("screen") || !json.contains("full")) {
+        qWarning() << "Invalid cascade file" << filePath;
+        return false;
+    }
+
+    const QDir dir = QFileInfo(filePath).absoluteDir();
+    screenPath = QDir::cleanPath(dir.absoluteFilePath(json["screen"].toString()));
+    fullPath = QDir::cleanPath(dir.absoluteFilePath(json["full"].toString()));
+    thresholds.rejectBelow = static_cast<float>(json["reject_below"].toDouble(0.0));
+    thresholds.acceptAbove = static_cast<float>(json["accept_above"].toDouble(1.0));
+    return true;
+}
+
+bool CascadeFile::write(const QString& filePath) const
+{
+    const QDir dir = QFileInfo(filePath).absoluteDir();
+    QJsonObject json;
+    json["screen"] = dir.relativeFilePath(screenPath);
+    json["full"] = dir.relativeFilePath(fullPath);
+    json["reject_below"] = thresholds.rejectBelow;
+    json["accept_above"] = thresholds.acceptAbove;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open cascade file for writing" << filePath << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson());
+    return file.commit();
+}
+
+Cascade::Cascade(const MLP& screen, const MLP& full, const CascadeThresholds& thresholds)
+    : screen(screen), full(full), thresholds(thresholds)
+{
+}
+
+bool Cascade::isValid() const
+{
+    const int screenSide = screen.getInputSide();
+    const int fullSide = full.getInputSide();
+    return screenSide > 0 && fullSide > 0 && screenSide <= fullSide;
+}
+
+Eigen::VectorXf Cascade::predictBatch(const QList<QImage>& images, Context& context) const
+{
+    // Screen every image from a thumbnail
+    const int screenSide = screen.getInputSide();
+    context.screenInputs.resize(screenSide * screenSide, images.size());
+    for (qsizetype i = 0; i < images.size(); ++i) {
+        MLP::preprocessImage(images.at(i), context.screenInputs.col(i), screenSide);
+    }
+    Eigen::VectorXf scores = screen.predictBatch(context.screenInputs, context.screen);
+
+    context.escalated.clear();
+    for (qsizetype i = 0; i < images.size(); ++i) {
+        if (isUncertain(scores(i))) {
+            context.escalated.push_back(static_cast<int>(i));
+        }
+    }
+    if (context.escalated.empty()) {
+        return scores;
+    }
+
+    // Only the uncertain images are preprocessed at full resolution
+    const int fullSide = full.getInputSide();
+    const Eigen::Index count = static_cast<Eigen::Index>(context.escalated.size());
+    context.fullInputs.resize(fullSide * fullSide, count);
+    for (Eigen::Index j = 0; j < count; ++j) {
+        MLP::preprocessImage(images.at(context.escalated[j]), context.fullInputs.col(j), fullSide);
+    }
+    const Eigen::VectorXf fullScores = full.predictBatch(context.fullInputs, context.full);
+    for (Eigen::Index j = 0; j < count; ++j) {
+        scores(context.escalated[j]) = fullScores(j);
+    }
+    return scores;
+}
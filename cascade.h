@@ -0,0 +1,122 @@
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include "mlp.h"
+#include </usr/local/include/Eigen/Dense>
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <vector>
+
+/**
+ * @brief Screening scores for which the Cascade trusts the screening model
+ *
+ * The defaults trust it for no score, so every image reaches the full model.
+ */
+struct CascadeThresholds
+{
+    float rejectBelow = 0.0f;   ///< Screening scores below this are final negatives
+    float acceptAbove = 1.0f;   ///< Screening scores above this are final positives
+};
+
+/**
+ * @brief Paths and thresholds of a cascade, as stored in a cascade file
+ *
+ * A cascade file is a small JSON document:
+ *
+ *   {"screen": "screen.senm", "full": "model.senm",
+ *    "reject_below": 0.04, "accept_above": 1.0}
+ *
+ * Relative model paths are resolved against the directory of the file.
+ */
+struct CascadeFile
+{
+    QString screenPath;             ///< Screening model
+    QString fullPath;               ///< Full model
+    CascadeThresholds thresholds;   ///< Uncertainty band
+
+    /**
+     * @brief Read a cascade file
+     * @param filePath Path of the cascade file
+     * @return True if successful, false otherwise
+     */
+    bool read(const QString& filePath);
+
+    /**
+     * @brief Write a cascade file, storing model paths relative to it
+     * @param filePath Path of the cascade file
+     * @return True if successful, false otherwise
+     */
+    bool write(const QString& filePath) const;
+};
+
+/**
+ * @brief The Cascade class scores images with a small screening model first
+ *
+ * Most images are easy negatives that a network looking at a 64x64 thumbnail
+ * rejects as well as the full 512x512 network, for a fraction of the cost.
+ * Every image is scored by the screening model; only images whose screening
+ * score falls inside [rejectBelow, acceptAbove] are preprocessed at full
+ * resolution and scored by the full model. Outside the band the screening
+ * score is the result.
+ *
+ * Both models are read concurrently and must outlive the cascade; any
+ * number of threads may score with it, each with its own Context.
+ */
+class Cascade
+{
+public:
+    /**
+     * @brief Scratch space of one thread
+     */
+    struct Context
+    {
+        MLP::InferenceContext screen;       ///< Activations of the screening model
+        MLP::InferenceContext full;         ///< Activations of the full model
+        Eigen::MatrixXf screenInputs;       ///< Thumbnails of the batch, one per column
+        Eigen::MatrixXf fullInputs;         ///< Full inputs of the escalated images
+        std::vector<int> escalated;         ///< Batch positions sent to the full model
+    };
+
+    /**
+     * @brief Cascade constructor
+     * @param screen Screening model taking small square images
+     * @param full Full model taking larger square images
+     * @param thresholds Uncertainty band of the screening score
+     */
+    Cascade(const MLP& screen, const MLP& full, const CascadeThresholds& thresholds);
+
+    /**
+     * @brief Whether both models take square images, the screening model's the smaller
+     * @return True if the models can form a cascade
+     */
+    bool isValid() const;
+
+    /**
+     * @brief Score a batch of images
+     * @param images Input images of any size
+     * @param context Scratch space of the calling thread; lists the escalated images afterwards
+     * @return Probability that each image contains the target object
+     */
+    Eigen::VectorXf predictBatch(const QList<QImage>& images, Context& context) const;
+
+    /**
+     * @brief Whether a screening score falls inside the uncertainty band
+     * @param score Screening score
+     * @return True if the full model has to decide
+     */
+    bool isUncertain(float score) const { return score >= thresholds.rejectBelow && score <= thresholds.acceptAbove; }
+
+    /**
+     * @brief Get the uncertainty band
+     * @return Thresholds of the screening score
+     */
+    const CascadeThresholds& getThresholds() const { return thresholds; }
+
+private:
+    const MLP& screen;
+    const MLP& full;
+    CascadeThresholds thresholds;
+};
+
+#endif // CASCADE_H
@@ -0,0 +1,91 @@
+#include "checkpointwriter.h"
+#include <QDebug>
+
+CheckpointWriter::CheckpointWriter(const QString& filePath, const MLP::BinaryOptions& options)
+    : filePath(filePath), options(options), writing(-1), pending(-1), lastWriteOk(true), stopping(false)
+{
+    thread = QThread::create([this]() { writerLoop(); });
+    thread->start(QThread::LowPriority);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+    }
+    snapshotReady.wakeAll();
+
+    thread->wait();
+    delete thread;
+}
+
+void CheckpointWriter::submit(const MLP& model, const QJsonObject& trainingState)
+{
+    // The buffer not being written is free to fill; a snapshot still
+    // pending in it is superseded
+    int target;
+    {
+        QMutexLocker locker(&mutex);
+        target = writing == 0 ? 1 : 0;
+        if (pending == target) {
+            pending = -1;
+        }
+    }
+
+    // Copy outside the lock so the writer can pick up the other buffer
+    // meanwhile; same-sized matrices are copied without reallocating
+    if (snapshots[target]) {
+        *snapshots[target] = model;
+    } else {
+        snapshots[target].reset(new MLP(model));
+    }
+    states[target] = trainingState;
+
+    {
+        QMutexLocker locker(&mutex);
+        pending = target;
+    }
+    snapshotReady.wakeOne();
+}
+
+bool CheckpointWriter::waitForIdle()
+{
+    QMutexLocker locker(&mutex);
+    while (pending >= 0 || writing >= 0) {
+        writeFinished.wait(&mutex);
+    }
+    return lastWriteOk;
+}
+
+void CheckpointWriter::writerLoop()
+{
+    QMutexLocker locker(&mutex);
+    while (true) {
+        while (pending < 0 && !stopping) {
+            snapshotReady.wait(&mutex);
+        }
+
+        // A snapshot submitted before stopping is still written
+        if (pending < 0) {
+            break;
+        }
+
+        writing = pending;
+        pending = -1;
+        const MLP* snapshot = snapshots[writing].get();
+        MLP::BinaryOptions snapshotOptions = options;
+        snapshotOptions.trainingState = states[writing];
+        locker.unlock();
+
+        const bool ok = snapshot->saveToBinary(filePath, snapshotOptions);
+        if (!ok) {
+            qWarning() << "Failed to write checkpoint" << filePath;
+        }
+
+        locker.relock();
+        writing = -1;
+        lastWriteOk = ok;
+        writeFinished.wakeAll();
+    }
+}
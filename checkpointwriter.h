@@ -0,0 +1,83 @@
+#ifndef CHECKPOINTWRITER_H
+#define CHECKPOINTWRITER_H
+
+#include "mlp.h"
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <memory>
+
+/**
+ * @brief When and where to save checkpoints during training
+ */
+struct CheckpointOptions
+{
+    QString filePath;           ///< Model file to keep up to date, empty to disable checkpoints
+    int intervalEpochs = 0;     ///< Save after every this many epochs, 0 to disable
+    int intervalMinutes = 0;    ///< Save when this many minutes have passed since the last save, 0 to disable
+};
+
+/**
+ * @brief The CheckpointWriter class saves snapshots of a model in the background
+ *
+ * submit() copies the model's parameters into one of two snapshot buffers
+ * and returns; a writer thread serializes the other buffer to a .senm file
+ * at the same time. The file is replaced atomically, so a crash during a
+ * write leaves the previous checkpoint intact. If a snapshot is submitted
+ * while an earlier one is still waiting to be written, the earlier one is
+ * dropped in favour of the newer.
+ */
+class CheckpointWriter
+{
+public:
+    /**
+     * @brief CheckpointWriter constructor
+     * @param filePath Model file to write
+     * @param options Binary format options
+     */
+    explicit CheckpointWriter(const QString& filePath, const MLP::BinaryOptions& options = MLP::BinaryOptions());
+
+    /**
+     * @brief Write any pending snapshot and stop the writer thread
+     */
+    ~CheckpointWriter();
+
+    /**
+     * @brief Snapshot a model for writing
+     *
+     * Costs one copy of the parameters; the model may be modified again as
+     * soon as this returns. Snapshots must be submitted from one thread.
+     *
+     * @param model Model to snapshot
+     * @param trainingState Training progress to store with it, see MLP::BinaryOptions
+     */
+    void submit(const MLP& model, const QJsonObject& trainingState = QJsonObject());
+
+    /**
+     * @brief Wait until every submitted snapshot has been written
+     * @return True if the last write succeeded
+     */
+    bool waitForIdle();
+
+private:
+    QString filePath;
+    MLP::BinaryOptions options;
+
+    // Snapshot buffers, allocated on first use, and the state saved with each
+    std::unique_ptr<MLP> snapshots[2];
+    QJsonObject states[2];
+
+    QThread* thread;
+    QMutex mutex;
+    QWaitCondition snapshotReady;
+    QWaitCondition writeFinished;
+    int writing;        // buffer being written, or -1
+    int pending;        // buffer waiting to be written, or -1
+    bool lastWriteOk;
+    bool stopping;
+
+    void writerLoop();
+};
+
+#endif // CHECKPOINTWRITER_H
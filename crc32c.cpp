@@ -0,0 +1,147 @@
+#include "crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+namespace {
+
+// Reflected Castagnoli polynomial
+const std::uint32_t POLYNOMIAL = 0x82F63B78;
+
+/**
+ * @brief Lookup tables for slicing-by-8
+ *
+ * Table 0 is the usual byte-at-a-time table; table k advances a byte that
+ * is followed by k more, so eight bytes are folded in per step.
+ */
+struct Tables
+{
+    std::uint32_t entries[8][256];
+
+    Tables()
+    {
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+            }
+            entries[0][i] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int i = 0; i < 256; ++i) {
+                entries[k][i] = (entries[k - 1][i] >> 8) ^ entries[0][entries[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+std::uint32_t crc32cTable(const unsigned char* data, std::size_t size, std::uint32_t crc)
+{
+    static const Tables tables;
+    const std::uint32_t (*t)[256] = tables.entries;
+
+    while (size >= 8) {
+        // Bytes are combined little-endian first, whatever the host order
+        const std::uint32_t low = crc ^ (static_cast<std::uint32_t>(data[0]) |
+                                         static_cast<std::uint32_t>(data[1]) << 8 |
+                                         static_cast<std::uint32_t>(data[2]) << 16 |
+                                         static_cast<std::uint32_t>(data[3]) << 24);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+std::uint32_t crc32cSse42(const unsigned char* data, std::size_t size, std::uint32_t crc)
+{
+    // Bring the pointer to an 8-byte boundary, then take 8 bytes at a time
+    while (size > 0 && (reinterpret_cast<std::uintptr_t>(data) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        --size;
+    }
+    std::uint64_t crc64 = crc;
+    while (size >= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+bool hasSse42()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int registers[4];
+    __cpuid(registers, 1);
+    return (registers[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#elif defined(CRC32C_ARM)
+
+std::uint32_t crc32cArm(const unsigned char* data, std::size_t size, std::uint32_t crc)
+{
+    while (size > 0 && (reinterpret_cast<std::uintptr_t>(data) & 7) != 0) {
+        crc = __crc32cb(crc, *data++);
+        --size;
+    }
+    while (size >= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+
+#endif
+
+} // namespace
+
+std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+
+#if defined(CRC32C_X86)
+    static const bool sse42 = hasSse42();
+    crc = sse42 ? crc32cSse42(bytes, size, crc) : crc32cTable(bytes, size, crc);
+#elif defined(CRC32C_ARM)
+    crc = crc32cArm(bytes, size, crc);
+#else
+    crc = crc32cTable(bytes, size, crc);
+#endif
+
+    return ~crc;
+}
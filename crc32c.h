@@ -0,0 +1,21 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Compute the CRC-32C (Castagnoli) checksum of a block of bytes
+ *
+ * Uses the CRC32 instructions of SSE4.2 or ARMv8 when the processor has
+ * them, which checksum several GB/s per core, and a table-driven
+ * implementation otherwise. Every implementation gives the same result.
+ *
+ * @param data Bytes to checksum
+ * @param size Number of bytes
+ * @param crc Checksum of the preceding bytes, to continue a checksum over several calls
+ * @return Checksum of the preceding bytes followed by data
+ */
+std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc = 0);
+
+#endif // CRC32C_H
@@ -0,0 +1,337 @@
+#include "datasetstore.h"
+#include "mlp.h"
+#include <QDirIterator>
+#include <QImageReader>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+DatasetStore::DatasetStore(int sampleWidth, int sampleHeight)
+    : sampleWidth(sampleWidth), sampleHeight(sampleHeight), threadCount(0), mappedPixels(nullptr)
+{
+}
+
+void DatasetStore::clear()
+{
+    pixels.clear();
+    labels.clear();
+    mappedPixels = nullptr;
+    packFile.reset();
+}
+
+void DatasetStore::setSampleSize(int width, int height)
+{
+    clear();
+    sampleWidth = width;
+    sampleHeight = height;
+}
+
+void DatasetStore::reserve(size_t count)
+{
+    pixels.reserve(count * sampleSize());
+    labels.reserve(count);
+}
+
+QStringList DatasetStore::imageFiles(const QString& dir)
+{
+    QStringList files;
+
+    QDirIterator it(dir, QStringList() << "*.png" << "*.bmp", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        files.append(it.next());
+    }
+
+    return files;
+}
+
+size_t DatasetStore::appendImages(const QStringList& filePaths, float label,
+                                  std::vector<QByteArray>* contentHashes)
+{
+    const size_t first = labels.size();
+    const size_t count = static_cast<size_t>(filePaths.size());
+    const size_t bytes = sampleSize();
+
+    detachFromPack();
+
+    // Reserve one slot per file up front so the decode tasks can write
+    // straight into the store without any locking
+    pixels.resize((first + count) * bytes);
+    std::vector<char> decoded(count, 0);
+    if (contentHashes) {
+        contentHashes->assign(count, QByteArray());
+    }
+
+    // Tasks only hold a path until they run, so the number of decoded images
+    // alive at once is bounded by the pool's thread count
+    QThreadPool pool;
+    if (threadCount > 0) {
+        pool.setMaxThreadCount(threadCount);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        pool.start([this, &filePaths, &decoded, contentHashes, i, first, bytes]() {
+            const QString& filePath = filePaths.at(static_cast<qsizetype>(i));
+            QImage image;
+            QByteArray hash;
+            {
+                // Read the file once and decode from memory, so hashing it
+                // does not cost a second read
+                QFile file(filePath);
+                if (!file.open(QIODevice::ReadOnly)) {
+                    qWarning() << "Failed to load image:" << filePath << file.errorString();
+                    return;
+                }
+                QByteArray data = file.readAll();
+                if (contentHashes) {
+                    hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+                }
+
+                QBuffer buffer(&data);
+                QImageReader reader(&buffer);
+                image = reader.read();
+                if (image.isNull()) {
+                    qWarning() << "Failed to load image:" << filePath << reader.errorString();
+                    return;
+                }
+            }
+
+            image = MLP::toInputImage(image, sampleWidth, sampleHeight);
+            uchar* record = pixels.data() + (first + i) * bytes;
+            for (int y = 0; y < sampleHeight; ++y) {
+                std::memcpy(record + static_cast<size_t>(y) * sampleWidth, image.constScanLine(y), sampleWidth);
+            }
+            decoded[i] = 1;
+            if (contentHashes) {
+                (*contentHashes)[i] = hash;
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // Close the gaps left by files that failed to decode
+    size_t appended = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!decoded[i]) {
+            continue;
+        }
+        if (appended != i) {
+            std::memmove(pixels.data() + (first + appended) * bytes,
+                         pixels.data() + (first + i) * bytes, bytes);
+        }
+        ++appended;
+    }
+    pixels.resize((first + appended) * bytes);
+    labels.resize(first + appended, label);
+
+    return appended;
+}
+
+void DatasetStore::retainSamples(const std::vector<char>& keep)
+{
+    detachFromPack();
+
+    const size_t bytes = sampleSize();
+    size_t kept = 0;
+    for (size_t i = 0; i < labels.size(); ++i) {
+        if (!keep[i]) {
+            continue;
+        }
+        if (kept != i) {
+            std::memmove(pixels.data() + kept * bytes, pixels.data() + i * bytes, bytes);
+            labels[kept] = labels[i];
+        }
+        ++kept;
+    }
+    pixels.resize(kept * bytes);
+    labels.resize(kept);
+}
+
+QByteArray DatasetStore::fileHash(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+    return hash.result();
+}
+
+void DatasetStore::detachFromPack()
+{
+    if (!mappedPixels) {
+        return;
+    }
+
+    pixels.assign(mappedPixels, mappedPixels + labels.size() * sampleSize());
+    mappedPixels = nullptr;
+    packFile.reset();
+}
+
+bool DatasetStore::loadPack(const QString& filePath)
+{
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(file.get());
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    // Read and verify the header
+    quint32 magicNumber;
+    quint8 formatVersion;
+    quint8 reserved[3];
+    quint32 width;
+    quint32 height;
+    quint64 count;
+    quint64 dataOffset;
+    stream >> magicNumber >> formatVersion >> reserved[0] >> reserved[1] >> reserved[2]
+           >> width >> height >> count >> dataOffset;
+
+    if (stream.status() != QDataStream::Ok || magicNumber != PACK_MAGIC_NUMBER ||
+        formatVersion != PACK_FORMAT_VERSION || width == 0 || height == 0) {
+        return false;
+    }
+
+    const quint64 bytes = static_cast<quint64>(width) * height;
+    if (dataOffset < PACK_HEADER_SIZE + count ||
+        dataOffset + count * bytes > static_cast<quint64>(file->size())) {
+        return false;
+    }
+
+    // Read labels
+    QByteArray rawLabels = file->read(static_cast<qint64>(count));
+    if (rawLabels.size() != static_cast<qsizetype>(count)) {
+        return false;
+    }
+
+    clear();
+    sampleWidth = static_cast<int>(width);
+    sampleHeight = static_cast<int>(height);
+    labels.resize(count);
+    for (quint64 i = 0; i < count; ++i) {
+        labels[i] = rawLabels.at(static_cast<qsizetype>(i)) ? 1.0f : 0.0f;
+    }
+
+    if (count == 0) {
+        return true;
+    }
+
+    // Map the records; fall back to one sequential read
+    uchar* mapped = file->map(static_cast<qint64>(dataOffset), static_cast<qint64>(count * bytes));
+    if (mapped) {
+        mappedPixels = mapped;
+        packFile = file;
+        return true;
+    }
+
+    pixels.resize(count * bytes);
+    if (!file->seek(static_cast<qint64>(dataOffset)) ||
+        file->read(reinterpret_cast<char*>(pixels.data()), static_cast<qint64>(pixels.size())) !=
+            static_cast<qint64>(pixels.size())) {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+qint64 DatasetStore::writePack(const QString& filePath, const QStringList& positiveFiles,
+                               const QStringList& negativeFiles, int sampleWidth, int sampleHeight)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return -1;
+    }
+
+    // Leave room for one label per listed file; files that fail to decode
+    // simply leave unused label bytes in front of the records
+    const quint64 capacity = static_cast<quint64>(positiveFiles.size() + negativeFiles.size());
+    const quint64 dataOffset = (PACK_HEADER_SIZE + capacity + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+    if (file.write(QByteArray(static_cast<qsizetype>(dataOffset), '\0')) != static_cast<qint64>(dataOffset)) {
+        file.cancelWriting();
+        return -1;
+    }
+
+    // Ingest and write a chunk of images at a time
+    const qsizetype chunkSize = 256;
+    QByteArray packedLabels;
+    DatasetStore chunk(sampleWidth, sampleHeight);
+    chunk.reserve(chunkSize);
+
+    const QStringList* sources[] = { &positiveFiles, &negativeFiles };
+    for (int label = 0; label < 2; ++label) {
+        const QStringList& files = *sources[label];
+        for (qsizetype start = 0; start < files.size(); start += chunkSize) {
+            chunk.clear();
+            size_t added = chunk.appendImages(files.mid(start, chunkSize), label == 0 ? 1.0f : 0.0f);
+
+            const qint64 bytes = static_cast<qint64>(added * chunk.sampleSize());
+            if (file.write(reinterpret_cast<const char*>(chunk.records()), bytes) != bytes) {
+                file.cancelWriting();
+                return -1;
+            }
+            packedLabels.append(QByteArray(static_cast<qsizetype>(added), label == 0 ? 1 : 0));
+        }
+    }
+
+    // Go back and fill in the header and labels
+    if (!file.seek(0)) {
+        file.cancelWriting();
+        return -1;
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << PACK_MAGIC_NUMBER << PACK_FORMAT_VERSION << quint8(0) << quint8(0) << quint8(0)
+           << static_cast<quint32>(sampleWidth) << static_cast<quint32>(sampleHeight)
+           << static_cast<quint64>(packedLabels.size()) << dataOffset;
+    stream.writeRawData(packedLabels.constData(), static_cast<int>(packedLabels.size()));
+
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        return -1;
+    }
+
+    return packedLabels.size();
+}
+
+void DatasetStore::copyInput(size_t index, Eigen::VectorXf& input) const
+{
+    Eigen::Map<const Eigen::Matrix<uchar, Eigen::Dynamic, 1>> record(sampleData(index), sampleSize());
+
+    // Normalize pixel values to [0, 1]
+    input = record.cast<float>() / 255.0f;
+}
+
+void DatasetStore::epochOrder(std::vector<int>& indices, quint64 seed, int epoch) const
+{
+    indices.resize(labels.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    // std::mt19937_64 and std::seed_seq are fully specified by the standard,
+    // unlike std::shuffle and the distributions, so the order is the same on
+    // every platform
+    std::seed_seq seq{static_cast<quint32>(seed), static_cast<quint32>(seed >> 32),
+                      static_cast<quint32>(epoch)};
+    std::mt19937_64 gen(seq);
+
+    // Fisher-Yates with rejection sampling to avoid modulo bias
+    for (size_t i = indices.size(); i > 1; --i) {
+        const quint64 bound = i;
+        const quint64 threshold = (0 - bound) % bound;
+        quint64 r;
+        do {
+            r = gen();
+        } while (r < threshold);
+        std::swap(indices[i - 1], indices[r % bound]);
+    }
+}
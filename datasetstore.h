@@ -0,0 +1,219 @@
+#ifndef DATASETSTORE_H
+#define DATASETSTORE_H
+
+#include </usr/local/include/Eigen/Dense>
+#include <QtGlobal>
+#include <QStringList>
+#include <QFile>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The DatasetStore class holds the preprocessed training samples
+ *
+ * Each sample is kept as one contiguous grayscale record of
+ * sampleWidth x sampleHeight bytes, a quarter of the size of the float input
+ * vector it expands to. Samples are appended during ingest and only moved
+ * when others are removed; the training loop visits them through an index
+ * permutation instead of reordering the samples themselves.
+ *
+ * A store can also be backed by a packed dataset file (.senp), in which case
+ * the records are memory-mapped straight from the file. The pack layout is,
+ * little-endian:
+ *
+ *   0   quint32  magic "SENP"
+ *   4   quint8   format version, followed by 3 reserved bytes
+ *   8   quint32  sample width
+ *   12  quint32  sample height
+ *   16  quint64  sample count
+ *   24  quint64  offset of the first record, a multiple of PACK_ALIGNMENT
+ *   32  quint8   one label (0 or 1) per sample
+ *   ... zero padding up to the first record
+ *       width x height bytes per record, stored back to back
+ */
+class DatasetStore
+{
+public:
+    /**
+     * @brief DatasetStore constructor
+     * @param sampleWidth Width of each sample in pixels
+     * @param sampleHeight Height of each sample in pixels
+     */
+    explicit DatasetStore(int sampleWidth = 512, int sampleHeight = 512);
+
+    /**
+     * @brief Remove all samples
+     */
+    void clear();
+
+    /**
+     * @brief Reserve space for a number of samples
+     * @param count Expected total number of samples
+     */
+    void reserve(size_t count);
+
+    /**
+     * @brief Set the number of threads used to decode images
+     * @param count Number of threads, or 0 for one per core
+     */
+    void setThreadCount(int count) { threadCount = count; }
+
+    /**
+     * @brief Change the size of the stored samples, dropping all samples
+     * @param width Width of each sample in pixels
+     * @param height Height of each sample in pixels
+     */
+    void setSampleSize(int width, int height);
+
+    /**
+     * @brief List the image files in a directory
+     * @param dir Directory to scan, including subdirectories
+     * @return Paths of the image files found
+     */
+    static QStringList imageFiles(const QString& dir);
+
+    /**
+     * @brief Decode, preprocess and append images
+     *
+     * Images are decoded on a thread pool and each decoded QImage is released
+     * as soon as its grayscale record has been written, so at most one
+     * decoded image per pool thread is alive at any time. Samples keep the
+     * order of filePaths; files that fail to decode are skipped.
+     *
+     * @param filePaths Image files to ingest
+     * @param label Target value for all of them (1 for positive, 0 for negative)
+     * @param contentHashes If not null, receives the content hash of each file,
+     *                      or an empty array for files that were skipped
+     * @return Number of samples appended
+     */
+    size_t appendImages(const QStringList& filePaths, float label,
+                        std::vector<QByteArray>* contentHashes = nullptr);
+
+    /**
+     * @brief Drop samples, keeping the order of the remaining ones
+     * @param keep One flag per sample; samples whose flag is zero are removed
+     */
+    void retainSamples(const std::vector<char>& keep);
+
+    /**
+     * @brief Hash the contents of a file the same way appendImages does
+     * @param filePath File to hash
+     * @return Content hash, or an empty array if the file cannot be read
+     */
+    static QByteArray fileHash(const QString& filePath);
+
+    /**
+     * @brief Replace the contents with a packed dataset file
+     *
+     * The records are memory-mapped when possible and read in one
+     * sequential pass otherwise.
+     *
+     * @param filePath Path of the .senp file
+     * @return True if successful, false otherwise
+     */
+    bool loadPack(const QString& filePath);
+
+    /**
+     * @brief Build a packed dataset file from image files
+     *
+     * Images are ingested and written in chunks, so memory use does not grow
+     * with the size of the dataset. The file is replaced atomically.
+     *
+     * @param filePath Path of the .senp file to write
+     * @param positiveFiles Images labelled 1
+     * @param negativeFiles Images labelled 0
+     * @param sampleWidth Width of each record in pixels
+     * @param sampleHeight Height of each record in pixels
+     * @return Number of samples written, or -1 on failure
+     */
+    static qint64 writePack(const QString& filePath, const QStringList& positiveFiles,
+                            const QStringList& negativeFiles, int sampleWidth = 512, int sampleHeight = 512);
+
+    /**
+     * @brief Get the number of samples
+     * @return Number of samples
+     */
+    size_t size() const { return labels.size(); }
+
+    /**
+     * @brief Check whether the store is empty
+     * @return True if there are no samples
+     */
+    bool isEmpty() const { return labels.empty(); }
+
+    /**
+     * @brief Get the width of each sample
+     * @return Width in pixels
+     */
+    int getSampleWidth() const { return sampleWidth; }
+
+    /**
+     * @brief Get the height of each sample
+     * @return Height in pixels
+     */
+    int getSampleHeight() const { return sampleHeight; }
+
+    /**
+     * @brief Get the number of pixels in each sample
+     * @return Pixels per sample
+     */
+    size_t sampleSize() const { return static_cast<size_t>(sampleWidth) * sampleHeight; }
+
+    /**
+     * @brief Get the grayscale record of a sample
+     * @param index Sample index
+     * @return Pointer to sampleSize() bytes
+     */
+    const uchar* sampleData(size_t index) const { return records() + index * sampleSize(); }
+
+    /**
+     * @brief Get the target value of a sample
+     * @param index Sample index
+     * @return Target value
+     */
+    float label(size_t index) const { return labels[index]; }
+
+    /**
+     * @brief Expand a sample into a normalized network input
+     * @param index Sample index
+     * @param input Output vector, resized to sampleSize()
+     */
+    void copyInput(size_t index, Eigen::VectorXf& input) const;
+
+    /**
+     * @brief Fill indices with the visiting order for one epoch
+     *
+     * The permutation depends only on the seed, the epoch and the number of
+     * samples, so a run can be reproduced (or resumed at any epoch) from the
+     * seed alone.
+     *
+     * @param indices Output indices, resized to the number of samples
+     * @param seed Shuffle seed of the run
+     * @param epoch Zero-based epoch number
+     */
+    void epochOrder(std::vector<int>& indices, quint64 seed, int epoch) const;
+
+private:
+    // Constants for the packed dataset format
+    static const quint32 PACK_MAGIC_NUMBER = 0x504E4553; // "SENP" in little-endian
+    static const quint8 PACK_FORMAT_VERSION = 0x01;
+    static const quint64 PACK_HEADER_SIZE = 32;
+    static const quint64 PACK_ALIGNMENT = 4096;
+
+    int sampleWidth;
+    int sampleHeight;
+    int threadCount;
+    std::vector<uchar> pixels;
+    std::vector<float> labels;
+
+    // Mapped records when backed by a pack file
+    std::shared_ptr<QFile> packFile;
+    const uchar* mappedPixels;
+
+    const uchar* records() const { return mappedPixels ? mappedPixels : pixels.data(); }
+
+    // Copy mapped records into owned memory before modifying them
+    void detachFromPack();
+};
+
+#endif // DATASETSTORE_H
@@ -0,0 +1,97 @@
+#include "imagescanner.h"
+#include <QDirIterator>
+#include <QImageReader>
+#include <QElapsedTimer>
+#include <QMetaObject>
+
+ImageScanner::ImageScanner(QObject* parent)
+    : QObject(parent), generation(0), running(false)
+{
+    // One scan at a time; a cancelled scan stops at its next file
+    pool.setMaxThreadCount(1);
+}
+
+ImageScanner::~ImageScanner()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+void ImageScanner::start(const QString& dir)
+{
+    const int scanGeneration = generation.fetchAndAddOrdered(1) + 1;
+    running = true;
+    pool.start([this, dir, scanGeneration]() { scan(dir, scanGeneration); });
+}
+
+void ImageScanner::cancel()
+{
+    generation.fetchAndAddOrdered(1);
+    running = false;
+}
+
+bool ImageScanner::probe(const QString& filePath)
+{
+    // canRead() and size() only look at the header
+    QImageReader reader(filePath);
+    if (!reader.canRead()) {
+        return false;
+    }
+
+    const QSize size = reader.size();
+    return !size.isValid() || !size.isEmpty();
+}
+
+void ImageScanner::scan(const QString& dir, int scanGeneration)
+{
+    // Batches are flushed by size or age, whichever comes first, so the list
+    // fills in steadily without flooding the event loop
+    const qsizetype maxBatchSize = 1024;
+    const qint64 maxBatchAge = 100;
+
+    QStringList batch;
+    int count = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    QDirIterator it(dir, QStringList() << "*.png" << "*.bmp", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (generation.loadAcquire() != scanGeneration) {
+            return;
+        }
+
+        QString filePath = it.next();
+        if (!probe(filePath)) {
+            continue;
+        }
+
+        batch.append(filePath);
+        ++count;
+
+        if (batch.size() >= maxBatchSize || timer.hasExpired(maxBatchAge)) {
+            deliver(batch, scanGeneration, false, count);
+            batch.clear();
+            timer.restart();
+        }
+    }
+
+    deliver(batch, scanGeneration, true, count);
+}
+
+void ImageScanner::deliver(const QStringList& batch, int scanGeneration, bool last, int count)
+{
+    // The generation is checked again in the scanner's thread, where start()
+    // and cancel() run, so a batch can never arrive after a cancel
+    QMetaObject::invokeMethod(this, [this, batch, scanGeneration, last, count]() {
+        if (generation.loadAcquire() != scanGeneration) {
+            return;
+        }
+        if (!batch.isEmpty()) {
+            emit imagesFound(batch);
+        }
+        if (last) {
+            running = false;
+            emit finished(count);
+        }
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,86 @@
+#ifndef IMAGESCANNER_H
+#define IMAGESCANNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+/**
+ * @brief The ImageScanner class lists the readable images in a directory in the background
+ *
+ * Each file is validated from its header only: the reader must recognise the
+ * format and, where the format reports one, the image size must not be
+ * empty. Nothing is decoded. Results are delivered in batches while the scan
+ * is running, so a large directory can be shown before it has been fully
+ * scanned.
+ *
+ * Signals are emitted in the thread the scanner lives in. Starting a new scan
+ * cancels the previous one, and no batch of a cancelled scan is delivered.
+ */
+class ImageScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief ImageScanner constructor
+     * @param parent Parent object
+     */
+    explicit ImageScanner(QObject* parent = nullptr);
+
+    /**
+     * @brief Cancel any running scan and wait for it to stop
+     */
+    ~ImageScanner();
+
+    /**
+     * @brief Start scanning a directory, cancelling any running scan
+     * @param dir Directory to scan, including subdirectories
+     */
+    void start(const QString& dir);
+
+    /**
+     * @brief Cancel the running scan, if any
+     */
+    void cancel();
+
+    /**
+     * @brief Check whether a scan is in progress
+     * @return True between start() and the matching finished() signal
+     */
+    bool isRunning() const { return running; }
+
+    /**
+     * @brief Check whether a file is a readable image without decoding it
+     * @param filePath File to probe
+     * @return True if the header is valid
+     */
+    static bool probe(const QString& filePath);
+
+signals:
+    /**
+     * @brief Signal emitted with each batch of readable images found
+     * @param filePaths Paths of the images, in directory iteration order
+     */
+    void imagesFound(const QStringList& filePaths);
+
+    /**
+     * @brief Signal emitted when a scan has completed
+     * @param count Total number of readable images found
+     */
+    void finished(int count);
+
+private:
+    QThreadPool pool;
+    QAtomicInt generation;   // bumped by start() and cancel(); stale scans stop
+    bool running;
+
+    // Runs on the pool thread
+    void scan(const QString& dir, int scanGeneration);
+
+    // Hand a batch over to the scanner's thread
+    void deliver(const QStringList& batch, int scanGeneration, bool last, int count);
+};
+
+#endif // IMAGESCANNER_H
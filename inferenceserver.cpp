@@ -0,0 +1,284 @@
+#include "inferenceserver.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QImageReader>
+#include <QBuffer>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Longest request line accepted, enough for a base64 encoded 32 MB image
+const qint64 MAX_REQUEST_BYTES = 48 * 1024 * 1024;
+
+// Interval of the statistics line while requests are coming in
+const int STATISTICS_INTERVAL_MS = 10000;
+
+// How long to wait for a server on an existing local socket to answer
+const int PROBE_TIMEOUT_MS = 1000;
+
+} // namespace
+
+InferenceServer::InferenceServer(std::shared_ptr<const MLP> model, const ServeOptions& options, QObject* parent)
+    : QObject(parent), model(std::move(model)), options(options), localServer(nullptr), tcpServer(nullptr),
+      stopping(false), requestCount(0), batchCount(0), pendingCount(0)
+{
+    if (options.decodeThreads > 0) {
+        decodePool.setMaxThreadCount(options.decodeThreads);
+    }
+    clock.start();
+
+    for (int i = 0; i < qMax(1, options.batchThreads); ++i) {
+        QThread* thread = QThread::create([this]() { batchLoop(); });
+        thread->start();
+        batchThreads.push_back(thread);
+    }
+
+    // Report the mean batch size, which shows how well requests coalesce
+    QTimer* statistics = new QTimer(this);
+    connect(statistics, &QTimer::timeout, this, [this]() {
+        const qint64 requests = requestCount.fetchAndStoreRelaxed(0);
+        const qint64 batches = batchCount.fetchAndStoreRelaxed(0);
+        if (batches > 0) {
+            qDebug().noquote() << QString("%1 requests/s, mean batch %2")
+                                      .arg(requests * 1000.0 / STATISTICS_INTERVAL_MS, 0, 'f', 1)
+                                      .arg(static_cast<double>(requests) / batches, 0, 'f', 1);
+        }
+    });
+    statistics->start(STATISTICS_INTERVAL_MS);
+}
+
+InferenceServer::~InferenceServer()
+{
+    decodePool.waitForDone();
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+    }
+    requestQueued.wakeAll();
+
+    for (QThread* thread : batchThreads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+bool InferenceServer::listenLocal(const QString& name)
+{
+    // Only a socket nobody answers on is left over from a server that died
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(PROBE_TIMEOUT_MS)) {
+        qWarning() << "Another server is already listening on" << name;
+        return false;
+    }
+    QLocalServer::removeServer(name);
+    localServer = new QLocalServer(this);
+    if (!localServer->listen(name)) {
+        qWarning() << "Failed to listen on" << name << localServer->errorString();
+        return false;
+    }
+    connect(localServer, &QLocalServer::newConnection, this, [this]() {
+        while (QLocalSocket* client = localServer->nextPendingConnection()) {
+            addClient(client);
+        }
+    });
+    return true;
+}
+
+bool InferenceServer::listenTcp(quint16 port)
+{
+    tcpServer = new QTcpServer(this);
+    if (!tcpServer->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Failed to listen on port" << port << tcpServer->errorString();
+        return false;
+    }
+    connect(tcpServer, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket* client = tcpServer->nextPendingConnection()) {
+            addClient(client);
+        }
+    });
+    return true;
+}
+
+void InferenceServer::addClient(QIODevice* client)
+{
+    // Responses to a client that has gone are dropped through its QPointer
+    connect(client, &QIODevice::readyRead, this, [this, client]() { readRequests(client); });
+    if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(client)) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    } else if (QTcpSocket* socket = qobject_cast<QTcpSocket*>(client)) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void InferenceServer::readRequests(QIODevice* client)
+{
+    while (client->canReadLine()) {
+        const QByteArray line = client->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError error;
+        const QJsonObject request = QJsonDocument::fromJson(line, &error).object();
+        const QJsonValue id = request["id"];
+        if (error.error != QJsonParseError::NoError) {
+            QJsonObject response;
+            response["error"] = "Invalid request: " + error.errorString();
+            respond(client, response);
+            continue;
+        }
+
+        if (!request.contains("path") && !request.contains("data")) {
+            QJsonObject response;
+            response["id"] = id;
+            response["error"] = "Request needs a path or data";
+            respond(client, response);
+            continue;
+        }
+
+        // Refuse requests beyond the limit rather than let the backlog grow
+        // without bound while clients send faster than batches are scored
+        if (pendingCount.fetchAndAddRelaxed(1) >= qMax(1, options.maxQueued)) {
+            pendingCount.fetchAndAddRelaxed(-1);
+            QJsonObject response;
+            response["id"] = id;
+            response["error"] = "Server busy, too many requests queued";
+            respond(client, response);
+            continue;
+        }
+
+        if (request.contains("path")) {
+            decode(client, id, request["path"].toString(), QByteArray());
+        } else {
+            decode(client, id, QString(), QByteArray::fromBase64(request["data"].toString().toLatin1()));
+        }
+    }
+
+    // A line that never ends would otherwise grow without bound
+    if (client->bytesAvailable() > MAX_REQUEST_BYTES) {
+        qWarning() << "Closing a client that sent an oversized request";
+        client->close();
+    }
+}
+
+void InferenceServer::decode(QPointer<QIODevice> client, const QJsonValue& id, const QString& path,
+                             const QByteArray& data)
+{
+    decodePool.start([this, client, id, path, data]() {
+        QImage image;
+        QString error;
+        if (!path.isEmpty()) {
+            QImageReader reader(path);
+            image = reader.read();
+            error = reader.errorString();
+        } else {
+            QByteArray bytes = data;
+            QBuffer buffer(&bytes);
+            QImageReader reader(&buffer);
+            image = reader.read();
+            error = reader.errorString();
+        }
+
+        if (image.isNull()) {
+            pendingCount.fetchAndAddRelaxed(-1);
+            QJsonObject response;
+            response["id"] = id;
+            response["error"] = "Failed to load image: " + error;
+            respond(client, response);
+            return;
+        }
+
+        Request request;
+        request.input = MLP::preprocessImage(image);
+        request.client = client;
+        request.id = id;
+        {
+            QMutexLocker locker(&mutex);
+            request.queuedNs = clock.nsecsElapsed();
+            queue.push_back(std::move(request));
+        }
+        requestQueued.wakeAll();
+    });
+}
+
+void InferenceServer::respond(QPointer<QIODevice> client, const QJsonObject& response)
+{
+    const QByteArray line = QJsonDocument(response).toJson(QJsonDocument::Compact) + '\n';
+
+    // Sockets may only be used from the thread they live in
+    QMetaObject::invokeMethod(this, [client, line]() {
+        if (client && client->isOpen()) {
+            client->write(line);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void InferenceServer::batchLoop()
+{
+    const qint64 maxDelayNs = static_cast<qint64>(options.maxDelayMs) * 1000000;
+    const size_t maxBatchSize = static_cast<size_t>(qMax(1, options.maxBatchSize));
+
+    // Scratch space of this thread, reused by every batch
+    MLP::InferenceContext context;
+    Eigen::MatrixXf inputs;
+    std::vector<Request> batch;
+
+    QMutexLocker locker(&mutex);
+    while (true) {
+        while (queue.empty() && !stopping) {
+            requestQueued.wait(&mutex);
+        }
+        if (queue.empty()) {
+            break;
+        }
+
+        // Give other requests until the oldest one's deadline to join
+        while (queue.size() < maxBatchSize && !stopping && !queue.empty()) {
+            const qint64 remainingNs = queue.front().queuedNs + maxDelayNs - clock.nsecsElapsed();
+            if (remainingNs <= 0) {
+                break;
+            }
+            requestQueued.wait(&mutex, static_cast<unsigned long>((remainingNs + 999999) / 1000000));
+        }
+
+        // Another thread may have taken the requests meanwhile
+        if (queue.empty()) {
+            continue;
+        }
+
+        const size_t count = std::min(queue.size(), maxBatchSize);
+        batch.clear();
+        for (size_t i = 0; i < count; ++i) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        locker.unlock();
+
+        inputs.resize(batch.front().input.size(), static_cast<Eigen::Index>(count));
+        for (size_t i = 0; i < count; ++i) {
+            inputs.col(static_cast<Eigen::Index>(i)) = batch[i].input;
+        }
+        const Eigen::VectorXf scores = model->predictBatch(inputs, context);
+
+        for (size_t i = 0; i < count; ++i) {
+            QJsonObject response;
+            response["id"] = batch[i].id;
+            response["score"] = scores(static_cast<Eigen::Index>(i));
+            response["batch"] = static_cast<int>(count);
+            respond(batch[i].client, response);
+        }
+        pendingCount.fetchAndAddRelaxed(-static_cast<int>(count));
+        requestCount.fetchAndAddRelaxed(static_cast<qint64>(count));
+        batchCount.fetchAndAddRelaxed(1);
+
+        locker.relock();
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef INFERENCESERVER_H
+#define INFERENCESERVER_H
+
+#include "mlp.h"
+#include <QObject>
+#include <QString>
+#include <QPointer>
+#include <QIODevice>
+#include <QJsonValue>
+#include <QThreadPool>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <deque>
+#include <memory>
+#include <vector>
+
+class QLocalServer;
+class QTcpServer;
+
+/**
+ * @brief How requests are batched by the InferenceServer
+ */
+struct ServeOptions
+{
+    int maxBatchSize = 32;      ///< Most requests scored together
+    int maxDelayMs = 2;         ///< Longest a request waits for others to join its batch
+    int batchThreads = 2;       ///< Threads running batches, each with its own scratch space
+    int decodeThreads = 0;      ///< Threads decoding images, 0 for one per core
+    int maxQueued = 1024;       ///< Most requests accepted but not yet answered; more are refused
+};
+
+/**
+ * @brief The InferenceServer class scores images for local clients with one shared model
+ *
+ * Clients connect over a local socket or to a localhost TCP port and send
+ * one JSON request per line:
+ *
+ *   {"id": 1, "path": "/absolute/path/image.png"}
+ *   {"id": 2, "data": "<base64 of an image file>"}
+ *
+ * and receive one JSON line per request, in completion order:
+ *
+ *   {"id": 1, "score": 0.93, "batch": 17}
+ *   {"id": 2, "error": "..."}
+ *
+ * Images are decoded on a thread pool. Decoded requests wait in a queue
+ * until maxBatchSize of them have arrived or the oldest has waited
+ * maxDelayMs, and are then scored together with MLP::predictBatch, so
+ * concurrent requests share one matrix product per layer. Once maxQueued
+ * requests are waiting to be decoded or scored, further requests are
+ * answered with an error straight away.
+ */
+class InferenceServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief InferenceServer constructor
+     * @param model Model to score with; read concurrently, so it must not be modified while serving
+     * @param options Batching options
+     * @param parent Parent object
+     */
+    InferenceServer(std::shared_ptr<const MLP> model, const ServeOptions& options, QObject* parent = nullptr);
+
+    /**
+     * @brief Stop the batch threads once the queued requests are scored
+     */
+    ~InferenceServer();
+
+    /**
+     * @brief Accept connections on a local socket
+     * @param name Socket name or path; a stale socket of the same name is removed, but
+     *        not one another server still accepts connections on
+     * @return True if listening
+     */
+    bool listenLocal(const QString& name);
+
+    /**
+     * @brief Accept connections on a TCP port of the loopback interface
+     * @param port Port number
+     * @return True if listening
+     */
+    bool listenTcp(quint16 port);
+
+private:
+    // A decoded request waiting to be scored
+    struct Request
+    {
+        Eigen::VectorXf input;
+        QPointer<QIODevice> client;
+        QJsonValue id;
+        qint64 queuedNs;
+    };
+
+    std::shared_ptr<const MLP> model;
+    ServeOptions options;
+    QLocalServer* localServer;
+    QTcpServer* tcpServer;
+    QThreadPool decodePool;
+
+    // Queue shared by the batch threads
+    std::deque<Request> queue;
+    QMutex mutex;
+    QWaitCondition requestQueued;
+    bool stopping;
+    std::vector<QThread*> batchThreads;
+    QElapsedTimer clock;
+
+    // Served since the last statistics line
+    QAtomicInteger<qint64> requestCount;
+    QAtomicInteger<qint64> batchCount;
+
+    // Requests accepted and not yet answered, limited by maxQueued
+    QAtomicInt pendingCount;
+
+    // Start reading requests from a new connection
+    void addClient(QIODevice* client);
+
+    // Parse the complete lines received from a client
+    void readRequests(QIODevice* client);
+
+    // Decode the image of a request on the pool and queue it
+    void decode(QPointer<QIODevice> client, const QJsonValue& id, const QString& path, const QByteArray& data);
+
+    // Send a response line; may be called from any thread
+    void respond(QPointer<QIODevice> client, const QJsonObject& response);
+
+    // Runs on each batch thread
+    void batchLoop();
+};
+
+#endif // INFERENCESERVER_H
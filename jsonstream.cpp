@@ -0,0 +1,461 @@
+#include "jsonstream.h"
+#include <charconv>
+#include <cmath>
+
+namespace {
+
+// Size of the read and write buffers
+const qsizetype BUFFER_SIZE = 1 << 20;
+
+// Nesting limit for skipped and captured values
+const int MAX_DEPTH = 512;
+
+// Longest number token accepted
+const int MAX_NUMBER_LENGTH = 64;
+
+bool isNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+bool isLiteralChar(char c)
+{
+    return isNumberChar(c) || (c >= 'a' && c <= 'z');
+}
+
+// Value of a hexadecimal digit, or -1
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Append a code point to UTF-8 text
+void appendUtf8(QByteArray& text, uint codePoint)
+{
+    if (codePoint < 0x80) {
+        text.append(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        text.append(static_cast<char>(0xC0 | (codePoint >> 6)));
+        text.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        text.append(static_cast<char>(0xE0 | (codePoint >> 12)));
+        text.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        text.append(static_cast<char>(0xF0 | (codePoint >> 18)));
+        text.append(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        text.append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.append(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+} // namespace
+
+JsonStreamWriter::JsonStreamWriter(QIODevice* device)
+    : device(device), error(false)
+{
+    buffer.reserve(BUFFER_SIZE);
+}
+
+JsonStreamWriter::~JsonStreamWriter()
+{
+    flush();
+}
+
+void JsonStreamWriter::write(const char* text)
+{
+    buffer.append(text);
+    if (buffer.size() >= BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void JsonStreamWriter::write(const QByteArray& text)
+{
+    buffer.append(text);
+    if (buffer.size() >= BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void JsonStreamWriter::writeString(const QString& value)
+{
+    QByteArray text;
+    text.append('"');
+    for (char c : value.toUtf8()) {
+        if (c == '"' || c == '\\') {
+            text.append('\\');
+            text.append(c);
+        } else if (static_cast<uchar>(c) < 0x20) {
+            const char* digits = "0123456789abcdef";
+            text.append("\\u00");
+            text.append(digits[static_cast<uchar>(c) >> 4]);
+            text.append(digits[c & 0xF]);
+        } else {
+            text.append(c);
+        }
+    }
+    text.append('"');
+    write(text);
+}
+
+void JsonStreamWriter::writeFloat(float value)
+{
+    if (!std::isfinite(value)) {
+        write("null");
+        return;
+    }
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    // Shortest representation that parses back to the same float
+    char text[32];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    buffer.append(text, static_cast<qsizetype>(result.ptr - text));
+    if (buffer.size() >= BUFFER_SIZE) {
+        flush();
+    }
+#else
+    // Nine significant digits always round-trip a float, if not always in the
+    // fewest digits; QByteArray::number ignores the C locale
+    write(QByteArray::number(static_cast<double>(value), 'g', 9));
+#endif
+}
+
+bool JsonStreamWriter::flush()
+{
+    if (!buffer.isEmpty()) {
+        if (device->write(buffer) != buffer.size()) {
+            error = true;
+        }
+        buffer.clear();
+    }
+    return !error;
+}
+
+JsonStreamReader::JsonStreamReader(QIODevice* device)
+    : device(device), position(0), error(false)
+{
+}
+
+bool JsonStreamReader::fill()
+{
+    if (position < buffer.size()) {
+        return true;
+    }
+
+    buffer.resize(BUFFER_SIZE);
+    const qint64 bytesRead = device->read(buffer.data(), BUFFER_SIZE);
+    buffer.resize(bytesRead > 0 ? static_cast<qsizetype>(bytesRead) : 0);
+    position = 0;
+    return !buffer.isEmpty();
+}
+
+char JsonStreamReader::peek()
+{
+    while (fill()) {
+        const char c = buffer.at(position);
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            return c;
+        }
+        ++position;
+    }
+    return 0;
+}
+
+bool JsonStreamReader::expect(char c)
+{
+    if (error || peek() != c) {
+        return fail();
+    }
+    ++position;
+    return true;
+}
+
+bool JsonStreamReader::fail()
+{
+    error = true;
+    return false;
+}
+
+bool JsonStreamReader::beginObject()
+{
+    return expect('{');
+}
+
+bool JsonStreamReader::nextKey(QString& key)
+{
+    if (error) {
+        return false;
+    }
+
+    char c = peek();
+    if (c == ',') {
+        ++position;
+        c = peek();
+    }
+    if (c == '}') {
+        ++position;
+        return false;
+    }
+    if (c != '"') {
+        return fail();
+    }
+
+    return readString(key, nullptr) && expect(':');
+}
+
+bool JsonStreamReader::beginArray()
+{
+    return expect('[');
+}
+
+bool JsonStreamReader::nextElement()
+{
+    if (error) {
+        return false;
+    }
+
+    char c = peek();
+    if (c == ',') {
+        ++position;
+        c = peek();
+    }
+    if (c == ']') {
+        ++position;
+        return false;
+    }
+    if (c == 0) {
+        return fail();
+    }
+    return true;
+}
+
+bool JsonStreamReader::readFloat(float& value)
+{
+    if (error || !isLiteralChar(peek())) {
+        return fail();
+    }
+
+    // Gather the token; it may straddle two buffer fills
+    char text[MAX_NUMBER_LENGTH];
+    int length = 0;
+    while (fill() && isLiteralChar(buffer.at(position))) {
+        if (length == MAX_NUMBER_LENGTH) {
+            return fail();
+        }
+        text[length++] = buffer.at(position++);
+    }
+
+    if (length == 4 && text[0] == 'n' && text[1] == 'u' && text[2] == 'l' && text[3] == 'l') {
+        value = 0.0f;
+        return true;
+    }
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars_result result = std::from_chars(text, text + length, value);
+    if (result.ec == std::errc() && result.ptr == text + length) {
+        return true;
+    }
+#endif
+
+    // Values outside the float range, and compilers without floating-point
+    // from_chars, go through double like QJsonValue::toDouble() would
+    bool ok = false;
+    const double number = QByteArray::fromRawData(text, length).toDouble(&ok);
+    if (!ok) {
+        return fail();
+    }
+    value = static_cast<float>(number);
+    return true;
+}
+
+bool JsonStreamReader::readString(QString& value, QByteArray* raw)
+{
+    if (!expect('"')) {
+        return false;
+    }
+    if (raw) {
+        raw->append('"');
+    }
+
+    QByteArray text;
+    uint highSurrogate = 0;
+    while (true) {
+        if (!fill()) {
+            return fail();
+        }
+
+        const char c = buffer.at(position++);
+        if (raw) {
+            raw->append(c);
+        }
+        if (c == '"') {
+            break;
+        }
+        if (c != '\\') {
+            text.append(c);
+            highSurrogate = 0;
+            continue;
+        }
+
+        if (!fill()) {
+            return fail();
+        }
+        const char escape = buffer.at(position++);
+        if (raw) {
+            raw->append(escape);
+        }
+
+        const uint pendingSurrogate = highSurrogate;
+        highSurrogate = 0;
+        switch (escape) {
+        case '"': text.append('"'); break;
+        case '\\': text.append('\\'); break;
+        case '/': text.append('/'); break;
+        case 'b': text.append('\b'); break;
+        case 'f': text.append('\f'); break;
+        case 'n': text.append('\n'); break;
+        case 'r': text.append('\r'); break;
+        case 't': text.append('\t'); break;
+        case 'u': {
+            uint codePoint = 0;
+            for (int i = 0; i < 4; ++i) {
+                if (!fill()) {
+                    return fail();
+                }
+                const char digit = buffer.at(position++);
+                if (raw) {
+                    raw->append(digit);
+                }
+                const int digitValue = hexValue(digit);
+                if (digitValue < 0) {
+                    return fail();
+                }
+                codePoint = codePoint * 16 + static_cast<uint>(digitValue);
+            }
+
+            // Characters outside the BMP are escaped as a surrogate pair
+            if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+                highSurrogate = codePoint;
+                break;
+            }
+            if (codePoint >= 0xDC00 && codePoint < 0xE000 && pendingSurrogate) {
+                codePoint = 0x10000 + ((pendingSurrogate - 0xD800) << 10) + (codePoint - 0xDC00);
+            }
+            appendUtf8(text, codePoint);
+            break;
+        }
+        default:
+            return fail();
+        }
+    }
+
+    value = QString::fromUtf8(text);
+    return true;
+}
+
+bool JsonStreamReader::readValue(QByteArray* raw, int depth)
+{
+    if (error || depth > MAX_DEPTH) {
+        return fail();
+    }
+
+    const char c = peek();
+    if (c == '{' || c == '[') {
+        const char close = c == '{' ? '}' : ']';
+        ++position;
+        if (raw) {
+            raw->append(c);
+        }
+
+        bool first = true;
+        while (true) {
+            char next = peek();
+            if (next == close) {
+                ++position;
+                if (raw) {
+                    raw->append(close);
+                }
+                return true;
+            }
+            if (!first) {
+                if (next != ',') {
+                    return fail();
+                }
+                ++position;
+                if (raw) {
+                    raw->append(',');
+                }
+            }
+            first = false;
+
+            if (c == '{') {
+                QString key;
+                if (!readString(key, raw) || !expect(':')) {
+                    return false;
+                }
+                if (raw) {
+                    raw->append(':');
+                }
+            }
+            if (!readValue(raw, depth + 1)) {
+                return false;
+            }
+        }
+    }
+
+    if (c == '"') {
+        QString value;
+        return readString(value, raw);
+    }
+
+    if (!isLiteralChar(c)) {
+        return fail();
+    }
+
+    // Numbers and the literals true, false and null
+    QByteArray token;
+    while (fill() && isLiteralChar(buffer.at(position))) {
+        if (token.size() == MAX_NUMBER_LENGTH) {
+            return fail();
+        }
+        token.append(buffer.at(position++));
+    }
+
+    bool ok = token == "true" || token == "false" || token == "null";
+    if (!ok) {
+        token.toDouble(&ok);
+    }
+    if (!ok) {
+        return fail();
+    }
+    if (raw) {
+        raw->append(token);
+    }
+    return true;
+}
+
+bool JsonStreamReader::readRaw(QByteArray& text)
+{
+    text.clear();
+    return readValue(&text, 0);
+}
+
+bool JsonStreamReader::skipValue()
+{
+    return readValue(nullptr, 0);
+}
+
+bool JsonStreamReader::atEnd()
+{
+    return peek() == 0;
+}
@@ -0,0 +1,183 @@
+#ifndef JSONSTREAM_H
+#define JSONSTREAM_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+/**
+ * @brief The JsonStreamWriter class writes JSON text through a fixed-size buffer
+ *
+ * The writer does not track structure; callers emit the punctuation
+ * themselves. It exists so that documents far larger than memory can be
+ * written without building a QJsonDocument first.
+ */
+class JsonStreamWriter
+{
+public:
+    /**
+     * @brief JsonStreamWriter constructor
+     * @param device Open device to write to
+     */
+    explicit JsonStreamWriter(QIODevice* device);
+
+    /**
+     * @brief Flush any buffered text
+     */
+    ~JsonStreamWriter();
+
+    /**
+     * @brief Write raw JSON text
+     * @param text Text to write as is
+     */
+    void write(const char* text);
+
+    /**
+     * @brief Write raw JSON text
+     * @param text Text to write as is
+     */
+    void write(const QByteArray& text);
+
+    /**
+     * @brief Write a string value, quoted and escaped
+     * @param value String to write
+     */
+    void writeString(const QString& value);
+
+    /**
+     * @brief Write a number in the shortest form that reads back as the same float
+     *
+     * Non-finite values are written as null, as QJsonDocument does.
+     *
+     * @param value Number to write
+     */
+    void writeFloat(float value);
+
+    /**
+     * @brief Write out the buffered text
+     * @return True if everything written so far reached the device
+     */
+    bool flush();
+
+    /**
+     * @brief Check whether a write to the device has failed
+     * @return True after a failed write
+     */
+    bool hasError() const { return error; }
+
+private:
+    QIODevice* device;
+    QByteArray buffer;
+    bool error;
+};
+
+/**
+ * @brief The JsonStreamReader class is a pull parser for JSON text
+ *
+ * The document is read through a fixed-size buffer and parsed one value at
+ * a time, so numbers can be stored straight into their destination instead
+ * of going through a QJsonDocument. The caller drives the parser according
+ * to the structure it expects; any mismatch sets the error flag, after which
+ * every call fails.
+ */
+class JsonStreamReader
+{
+public:
+    /**
+     * @brief JsonStreamReader constructor
+     * @param device Open device to read from
+     */
+    explicit JsonStreamReader(QIODevice* device);
+
+    /**
+     * @brief Consume the start of an object
+     * @return True if the next value is an object
+     */
+    bool beginObject();
+
+    /**
+     * @brief Move to the next member of the current object
+     *
+     * Consumes the closing brace when there are no more members.
+     *
+     * @param key Output member name
+     * @return True if a member follows, false at the end of the object or on error
+     */
+    bool nextKey(QString& key);
+
+    /**
+     * @brief Consume the start of an array
+     * @return True if the next value is an array
+     */
+    bool beginArray();
+
+    /**
+     * @brief Move to the next element of the current array
+     *
+     * Consumes the closing bracket when there are no more elements.
+     *
+     * @return True if an element follows, false at the end of the array or on error
+     */
+    bool nextElement();
+
+    /**
+     * @brief Read a number as a float
+     *
+     * null reads as 0, matching QJsonValue::toDouble().
+     *
+     * @param value Output value
+     * @return True if successful, false otherwise
+     */
+    bool readFloat(float& value);
+
+    /**
+     * @brief Read the text of the next value without interpreting it
+     * @param text Output JSON text of the value
+     * @return True if successful, false otherwise
+     */
+    bool readRaw(QByteArray& text);
+
+    /**
+     * @brief Skip the next value
+     * @return True if successful, false otherwise
+     */
+    bool skipValue();
+
+    /**
+     * @brief Check whether the input has been read completely
+     * @return True if only whitespace remains
+     */
+    bool atEnd();
+
+    /**
+     * @brief Check whether parsing has failed
+     * @return True after a syntax error, a type mismatch or a read failure
+     */
+    bool hasError() const { return error; }
+
+private:
+    QIODevice* device;
+    QByteArray buffer;
+    qsizetype position;
+    bool error;
+
+    // Make at least one unread byte available; false at end of input
+    bool fill();
+
+    // Skip whitespace and return the next byte without consuming it, or 0 at end of input
+    char peek();
+
+    // Consume an expected byte after optional whitespace
+    bool expect(char c);
+
+    // Read a string value; the opening quote must be next
+    bool readString(QString& value, QByteArray* raw);
+
+    // Read a value, optionally appending its text to raw
+    bool readValue(QByteArray* raw, int depth);
+
+    // Fail and stop parsing
+    bool fail();
+};
+
+#endif // JSONSTREAM_H
@@ -1,28 +1,66 @@
 #include "layer.h"
+#include "philox.h"
 #include <cmath>
 #include <random>
 
-Layer::Layer(int inputSize, int outputSize, const std::string& activationFunction)
-    : inputSize(inputSize), outputSize(outputSize), activationFunctionName(activationFunction)
+Layer::Layer(int inputSize, int outputSize, const std::string& activationFunction, bool initialize)
+    : inputSize(inputSize), outputSize(outputSize), activationFunctionName(activationFunction),
+      mappedWeights(nullptr), mappedBiases(nullptr)
 {
+    // Initialize activation functions
+    initializeActivationFunctions();
+
+    if (!initialize) {
+        // Allocate only; untouched pages of a large matrix are not even
+        // committed until the weights are written
+        weights.resize(outputSize, inputSize);
+        biases.resize(outputSize);
+        return;
+    }
+
     // Initialize weights with Xavier initialization
     std::random_device rd;
-    std::mt19937 gen(rd());
+    initializeWeights((static_cast<std::uint64_t>(rd()) << 32) | rd(), 0);
+}
+
+void Layer::initializeWeights(std::uint64_t seed, std::uint32_t stream)
+{
+    // Drop any mapped parameters; the layer owns its weights from here on
+    mappedWeights = nullptr;
+    mappedBiases = nullptr;
+    mappingOwner.reset();
+
+    // Xavier initialization
     float limit = std::sqrt(6.0f / (inputSize + outputSize));
-    std::uniform_real_distribution<float> dis(-limit, limit);
-    
-    weights = Eigen::MatrixXf(outputSize, inputSize);
-    for (int i = 0; i < outputSize; ++i) {
-        for (int j = 0; j < inputSize; ++j) {
-            weights(i, j) = dis(gen);
-        }
-    }
-    
+    weights.resize(outputSize, inputSize);
+    Philox4x32::fillUniform(weights.data(), static_cast<std::int64_t>(weights.size()), -limit, limit, seed, stream);
+
     // Initialize biases to zero
     biases = Eigen::VectorXf::Zero(outputSize);
-    
-    // Initialize activation functions
-    initializeActivationFunctions();
+}
+
+void Layer::mapParameters(const float* weights, const float* biases, const std::shared_ptr<const void>& owner)
+{
+    mappedWeights = weights;
+    mappedBiases = biases;
+    mappingOwner = owner;
+
+    // The layer's own copies are no longer needed
+    this->weights.resize(0, 0);
+    this->biases.resize(0);
+}
+
+void Layer::detach()
+{
+    if (!mappedWeights) {
+        return;
+    }
+
+    weights = WeightMap(mappedWeights, outputSize, inputSize);
+    biases = BiasMap(mappedBiases, outputSize);
+    mappedWeights = nullptr;
+    mappedBiases = nullptr;
+    mappingOwner.reset();
 }
 
 void Layer::initializeActivationFunctions()
@@ -64,23 +102,49 @@ void Layer::initializeActivationFunctions()
 
 Eigen::VectorXf Layer::forward(const Eigen::VectorXf& input)
 {
-    // Cache input for backpropagation
+    // Cache input, weighted sum and output for backpropagation
     lastInput = input;
-    
+    infer(input, lastZ, lastOutput);
+    return lastOutput;
+}
+
+void Layer::infer(const Eigen::VectorXf& input, Eigen::VectorXf& z, Eigen::VectorXf& output) const
+{
     // Calculate weighted sum: z = Wx + b
-    lastZ = weights * input + biases;
-    
+    z.noalias() = getWeights() * input;
+    z += getBiases();
+
+    activate(z, output);
+}
+
+void Layer::activate(const Eigen::VectorXf& z, Eigen::VectorXf& output) const
+{
     // Apply activation function element-wise
-    lastOutput = Eigen::VectorXf(outputSize);
+    output.resize(outputSize);
     for (int i = 0; i < outputSize; ++i) {
-        lastOutput(i) = activation(lastZ(i));
+        output(i) = activation(z(i));
+    }
+}
+
+void Layer::inferBatch(const Eigen::Ref<const Eigen::MatrixXf>& inputs, Eigen::MatrixXf& outputs) const
+{
+    // Weighted sums of the whole batch: Z = WX + b
+    outputs.noalias() = getWeights() * inputs;
+    outputs.colwise() += getBiases();
+
+    // Apply activation function element-wise, in place
+    float* values = outputs.data();
+    const Eigen::Index count = outputs.size();
+    for (Eigen::Index i = 0; i < count; ++i) {
+        values[i] = activation(values[i]);
     }
-    
-    return lastOutput;
 }
 
 Eigen::VectorXf Layer::backward(const Eigen::VectorXf& outputGradient, float learningRate)
 {
+    // Mapped parameters are read-only; take a copy before updating them
+    detach();
+
     // Calculate gradient of activation function
     Eigen::VectorXf activationGradient(outputSize);
     for (int i = 0; i < outputSize; ++i) {
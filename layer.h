@@ -2,9 +2,30 @@
 #define LAYER_H
 
 #include </usr/local/include/Eigen/Dense>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 
+/**
+ * @brief Weight matrix type of a layer
+ *
+ * Weights are stored row-major, one row per output neuron, which is also the
+ * order they are serialized in, so a whole matrix can be read or written as
+ * one contiguous block.
+ */
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> WeightMatrix;
+
+/**
+ * @brief Read-only view of a layer's weights, owned or mapped
+ */
+typedef Eigen::Map<const WeightMatrix> WeightMap;
+
+/**
+ * @brief Read-only view of a layer's biases, owned or mapped
+ */
+typedef Eigen::Map<const Eigen::VectorXf> BiasMap;
+
 /**
  * @brief The Layer class represents a single layer in a neural network
  */
@@ -16,15 +37,59 @@ public:
      * @param inputSize Number of input neurons
      * @param outputSize Number of output neurons
      * @param activationFunction Activation function to use
+     * @param initialize Whether to initialize the weights and biases; pass false
+     *                   when they are about to be overwritten, e.g. by a model file
      */
-    Layer(int inputSize, int outputSize, const std::string& activationFunction = "sigmoid");
+    Layer(int inputSize, int outputSize, const std::string& activationFunction = "sigmoid",
+          bool initialize = true);
     
+    /**
+     * @brief Reinitialize the weights with Xavier initialization and the biases with zero
+     *
+     * The weights are drawn from a counter-based generator in parallel; the
+     * result depends only on seed and stream.
+     *
+     * @param seed Seed of the generator
+     * @param stream Sequence to draw from, so layers sharing a seed differ
+     */
+    void initializeWeights(std::uint64_t seed, std::uint32_t stream);
+
     /**
      * @brief Forward pass through the layer
      * @param input Input values
      * @return Output values after activation
      */
     Eigen::VectorXf forward(const Eigen::VectorXf& input);
+
+    /**
+     * @brief Forward pass that leaves the layer untouched
+     *
+     * Unlike forward(), nothing is cached for backpropagation, so any number
+     * of threads may call this on the same layer at once.
+     *
+     * @param input Input values
+     * @param z Output pre-activation values, resized as needed
+     * @param output Output values after activation, resized as needed
+     */
+    void infer(const Eigen::VectorXf& input, Eigen::VectorXf& z, Eigen::VectorXf& output) const;
+
+    /**
+     * @brief Forward pass over a batch of inputs that leaves the layer untouched
+     *
+     * One matrix product for the whole batch, so the weights are read once
+     * per batch rather than once per input.
+     *
+     * @param inputs One input per column
+     * @param outputs Output values after activation, one column per input, resized as needed
+     */
+    void inferBatch(const Eigen::Ref<const Eigen::MatrixXf>& inputs, Eigen::MatrixXf& outputs) const;
+
+    /**
+     * @brief Apply the activation function to pre-activation values computed elsewhere
+     * @param z Pre-activation values
+     * @param output Output values after activation, resized as needed
+     */
+    void activate(const Eigen::VectorXf& z, Eigen::VectorXf& output) const;
     
     /**
      * @brief Backward pass through the layer
@@ -38,25 +103,56 @@ public:
      * @brief Get the weights of the layer
      * @return Weight matrix
      */
-    const Eigen::MatrixXf& getWeights() const { return weights; }
+    WeightMap getWeights() const { return WeightMap(mappedWeights ? mappedWeights : weights.data(), outputSize, inputSize); }
     
     /**
      * @brief Set the weights of the layer
      * @param newWeights New weight matrix
      */
-    void setWeights(const Eigen::MatrixXf& newWeights) { weights = newWeights; }
+    void setWeights(const WeightMatrix& newWeights) { detach(); weights = newWeights; }
+
+    /**
+     * @brief Get the weight storage for in-place loading
+     * @return Pointer to outputSize x inputSize floats in row-major order
+     */
+    float* weightData() { detach(); return weights.data(); }
     
     /**
      * @brief Get the biases of the layer
      * @return Bias vector
      */
-    const Eigen::VectorXf& getBiases() const { return biases; }
+    BiasMap getBiases() const { return BiasMap(mappedBiases ? mappedBiases : biases.data(), outputSize); }
     
     /**
      * @brief Set the biases of the layer
      * @param newBiases New bias vector
      */
-    void setBiases(const Eigen::VectorXf& newBiases) { biases = newBiases; }
+    void setBiases(const Eigen::VectorXf& newBiases) { detach(); biases = newBiases; }
+
+    /**
+     * @brief Get the bias storage for in-place loading
+     * @return Pointer to outputSize floats
+     */
+    float* biasData() { detach(); return biases.data(); }
+
+    /**
+     * @brief Use parameters that live in external memory instead of copies
+     *
+     * The layer reads its weights and biases straight from the given memory
+     * until they are modified, at which point it copies them into storage of
+     * its own.
+     *
+     * @param weights outputSize x inputSize floats in row-major order
+     * @param biases outputSize floats
+     * @param owner Keeps the memory alive for as long as the layer uses it
+     */
+    void mapParameters(const float* weights, const float* biases, const std::shared_ptr<const void>& owner);
+
+    /**
+     * @brief Check whether the parameters are used from external memory
+     * @return True if mapped
+     */
+    bool isMapped() const { return mappedWeights != nullptr; }
     
     /**
      * @brief Get the activation function name
@@ -97,9 +193,17 @@ public:
 private:
     int inputSize;
     int outputSize;
-    Eigen::MatrixXf weights;
+    WeightMatrix weights;
     Eigen::VectorXf biases;
     std::string activationFunctionName;
+
+    // External parameters, used instead of weights and biases when set
+    const float* mappedWeights;
+    const float* mappedBiases;
+    std::shared_ptr<const void> mappingOwner;
+
+    // Copy external parameters into the layer's own storage
+    void detach();
     
     // Activation functions
     std::function<float(float)> activation;
@@ -1,25 +1,37 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QDebug>
-#include <QDirIterator>
-#include <QImageReader>
 #include <QFileInfo>
 #include <QDateTime>
 #include <QStandardPaths>
+#include <QSet>
+
+namespace {
+
+// Whether a path is a directory or lies below it
+bool isInDirectory(const QString& path, const QString& dir)
+{
+    return !dir.isEmpty() && (path == dir || path.startsWith(dir + '/'));
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , currentImageIndex(-1)
     , isCurrentImagePositive(false)
+    , workerBusy(false)
+    , modelTraining(false)
+    , resumingTraining(false)
 {
     ui->setupUi(static_cast<QMainWindow*>(this));
 
     // Initialize MLP with 512x512 input, 128 hidden neurons, and 1 output neuron
-    mlp = new MLP(512 * 512, 128, 1, "sigmoid", "sigmoid");
+    mlp = std::make_shared<MLP>(512 * 512, 128, 1, "sigmoid", "sigmoid");
 
     // Initialize worker thread
-    worker = new TrainingWorker(mlp);
+    worker = new TrainingWorker(mlp.get());
     worker->moveToThread(&workerThread);
 
     // Connect signals and slots
@@ -27,11 +39,40 @@ MainWindow::MainWindow(QWidget *parent)
     connect(worker, &TrainingWorker::progressUpdated, this, &MainWindow::onTrainingProgressUpdated);
     connect(worker, &TrainingWorker::epochCompleted, this, &MainWindow::onEpochCompleted);
     connect(worker, &TrainingWorker::trainingComplete, this, &MainWindow::onTrainingComplete);
+    connect(worker, &TrainingWorker::trainingFailed, this, &MainWindow::onTrainingFailed);
+    connect(worker, &TrainingWorker::screeningComplete, this, &MainWindow::onScreeningComplete);
     connect(worker, &TrainingWorker::evaluationComplete, this, &MainWindow::onEvaluationComplete);
+    connect(worker, &TrainingWorker::evaluationFailed, this, &MainWindow::onEvaluationFailed);
+    connect(worker, &TrainingWorker::modelExported, this, &MainWindow::onModelExported);
+    connect(worker, &TrainingWorker::modelImported, this, &MainWindow::onModelImported);
 
     // Start worker thread
     workerThread.start();
 
+    // Directories are scanned in the background and the lists filled in as
+    // results arrive
+    positiveScanner = new ImageScanner(this);
+    negativeScanner = new ImageScanner(this);
+    connect(positiveScanner, &ImageScanner::imagesFound, this,
+            [this](const QStringList& filePaths) { onImagesScanned(true, filePaths); });
+    connect(negativeScanner, &ImageScanner::imagesFound, this,
+            [this](const QStringList& filePaths) { onImagesScanned(false, filePaths); });
+    connect(positiveScanner, &ImageScanner::finished, this, [this](int count) { onImageScanFinished(true, count); });
+    connect(negativeScanner, &ImageScanner::finished, this, [this](int count) { onImageScanFinished(false, count); });
+
+    // Images added to the directories later are picked up by a rescan once
+    // the changes settle, so the lists handed to the worker stay current
+    directoryWatcher = new QFileSystemWatcher(this);
+    rescanTimer = new QTimer(this);
+    rescanTimer->setSingleShot(true);
+    rescanTimer->setInterval(RESCAN_DELAY_MS);
+    for (int i = 0; i < 2; ++i) {
+        rescanPending[i] = false;
+        rescanning[i] = false;
+    }
+    connect(directoryWatcher, &QFileSystemWatcher::directoryChanged, this, &MainWindow::onDirectoryChanged);
+    connect(rescanTimer, &QTimer::timeout, this, &MainWindow::rescanChangedDirectories);
+
     // Initialize UI
     initializeUI();
 
@@ -47,7 +88,7 @@ MainWindow::~MainWindow()
     workerThread.wait();
 
     // Clean up
-    delete mlp;
+    mlp.reset();
     delete ui;
 
     // Clean up graphics scenes
@@ -96,6 +137,34 @@ void MainWindow::initializeUI()
     ui->cbShuffle->setChecked(true);
     ui->sbBias->setValue(0.0);
 
+    // Add the data augmentation toggle below "Shuffle Data"
+    augmentCheckBox = new QCheckBox();
+    augmentCheckBox->setToolTip("Randomly flip, rotate and shift training images each epoch");
+    ui->gridLayout_3->addWidget(new QLabel("Augment Data:"), 4, 0, 1, 1);
+    ui->gridLayout_3->addWidget(augmentCheckBox, 4, 1, 1, 1);
+
+    // Add the checkpoint interval below it
+    checkpointSpinBox = new QSpinBox();
+    checkpointSpinBox->setRange(0, 24 * 60);
+    checkpointSpinBox->setSuffix(" min");
+    checkpointSpinBox->setSpecialValueText("Off");
+    checkpointSpinBox->setToolTip("Save the model in the background at this interval while training, to " +
+                                  checkpointPath());
+    ui->gridLayout_3->addWidget(new QLabel("Checkpoint Every:"), 5, 0, 1, 1);
+    ui->gridLayout_3->addWidget(checkpointSpinBox, 5, 1, 1, 1);
+
+    // Continuing an interrupted run from that checkpoint
+    resumeButton = new QPushButton("Resume From Checkpoint");
+    resumeButton->setToolTip("Continue the run saved in " + checkpointPath() + " where it stopped");
+    connect(resumeButton, &QPushButton::clicked, this, &MainWindow::onResumeTrainingClicked);
+    ui->gridLayout_3->addWidget(resumeButton, 6, 0, 1, 2);
+
+    // Evaluating through a screening cascade built by sensuser-cascade
+    screeningButton = new QPushButton("Evaluate With Screening...");
+    screeningButton->setToolTip("Let the screening model of a cascade file decide the easy images during evaluation");
+    connect(screeningButton, &QPushButton::clicked, this, &MainWindow::onScreeningCascadeClicked);
+    ui->gridLayout_3->addWidget(screeningButton, 7, 0, 1, 2);
+
     // Setup hidden layers configuration UI
     setupHiddenLayersUI();
 
@@ -126,6 +195,7 @@ void MainWindow::initializeUI()
 
     // Disable buttons that require data
     ui->btnTrain->setEnabled(false);
+    resumeButton->setEnabled(false);
     ui->btnEvaluate->setEnabled(false);
     ui->btnNextImage->setEnabled(false);
     ui->btnPrevImage->setEnabled(false);
@@ -138,18 +208,166 @@ void MainWindow::initializeUI()
     currentHiddenLayerIndex = 0;
 }
 
-void MainWindow::loadImagesFromDir(const QString& dir, QStringList& imageList)
+void MainWindow::startImageScan(bool positive, const QString& dir)
 {
+    QStringList& imageList = positive ? positiveImages : negativeImages;
     imageList.clear();
 
-    QDirIterator it(dir, QStringList() << "*.png" << "*.bmp", QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QString filePath = it.next();
-        QImageReader reader(filePath);
-        if (reader.canRead()) {
-            imageList.append(filePath);
+    // A rescan of the directory being replaced is abandoned
+    const int side = positive ? 0 : 1;
+    rescanPending[side] = false;
+    rescanning[side] = false;
+    rescannedImages[side].clear();
+
+    // Only the directories of the current examples are watched
+    QStringList unwatched;
+    for (const QString& watched : directoryWatcher->directories()) {
+        if (!isInDirectory(watched, positiveDir) && !isInDirectory(watched, negativeDir)) {
+            unwatched.append(watched);
+        }
+    }
+    if (!unwatched.isEmpty()) {
+        directoryWatcher->removePaths(unwatched);
+    }
+    if (!directoryWatcher->directories().contains(dir)) {
+        directoryWatcher->addPath(dir);
+    }
+
+    // Files may have changed since they were cached
+    thumbnailCache.clear();
+
+    // Drop the current image if it belonged to the list being replaced
+    if (currentImageIndex >= 0 && isCurrentImagePositive == positive) {
+        currentImageIndex = -1;
+        ui->btnNextImage->setEnabled(false);
+        ui->btnPrevImage->setEnabled(false);
+        updateCurrentImage();
+    }
+
+    (positive ? positiveScanner : negativeScanner)->start(dir);
+    updateDatasetButtons();
+
+    statusBar()->showMessage(QString("Scanning %1...").arg(dir));
+}
+
+void MainWindow::onImagesScanned(bool positive, const QStringList& filePaths)
+{
+    watchDirectories(filePaths);
+
+    // A rescan builds a new list, leaving the current one in use until it is done
+    const int side = positive ? 0 : 1;
+    if (rescanning[side]) {
+        rescannedImages[side].append(filePaths);
+        return;
+    }
+
+    QStringList& imageList = positive ? positiveImages : negativeImages;
+    imageList.append(filePaths);
+
+    // Show the first image as soon as there is one: the first positive image
+    // always, the first negative image only if nothing is shown yet
+    if (currentImageIndex < 0 || (positive && !isCurrentImagePositive && imageList.size() == filePaths.size())) {
+        currentImageIndex = 0;
+        isCurrentImagePositive = positive;
+        ui->btnPrevImage->setEnabled(false);
+        updateCurrentImage();
+    }
+
+    if (isCurrentImagePositive == positive) {
+        ui->btnNextImage->setEnabled(currentImageIndex < imageList.size() - 1);
+    }
+}
+
+void MainWindow::onImageScanFinished(bool positive, int count)
+{
+    const int side = positive ? 0 : 1;
+    if (rescanning[side]) {
+        rescanning[side] = false;
+
+        // Keep showing the current image if it is still there
+        QStringList& imageList = positive ? positiveImages : negativeImages;
+        const bool showing = currentImageIndex >= 0 && isCurrentImagePositive == positive;
+        const QString currentPath = showing ? imageList.at(currentImageIndex) : QString();
+        imageList = rescannedImages[side];
+        rescannedImages[side].clear();
+
+        // Files may have changed since they were cached
+        thumbnailCache.clear();
+
+        if (showing) {
+            currentImageIndex = static_cast<int>(imageList.indexOf(currentPath));
+            if (currentImageIndex < 0) {
+                currentImageIndex = imageList.isEmpty() ? -1 : 0;
+                updateCurrentImage();
+            }
+            ui->btnPrevImage->setEnabled(currentImageIndex > 0);
+            ui->btnNextImage->setEnabled(currentImageIndex >= 0 && currentImageIndex < imageList.size() - 1);
+        }
+    }
+
+    statusBar()->showMessage(QString("Found %1 %2 images").arg(count).arg(positive ? "positive" : "negative"), 5000);
+    updateDatasetButtons();
+}
+
+void MainWindow::watchDirectories(const QStringList& filePaths)
+{
+    QSet<QString> dirs;
+    for (const QString& filePath : filePaths) {
+        dirs.insert(QFileInfo(filePath).absolutePath());
+    }
+    for (const QString& watched : directoryWatcher->directories()) {
+        dirs.remove(watched);
+    }
+    if (!dirs.isEmpty()) {
+        directoryWatcher->addPaths(dirs.values());
+    }
+}
+
+void MainWindow::onDirectoryChanged(const QString& path)
+{
+    if (isInDirectory(path, positiveDir)) {
+        rescanPending[0] = true;
+    }
+    if (isInDirectory(path, negativeDir)) {
+        rescanPending[1] = true;
+    }
+
+    // Restarting the timer turns a burst of changes into one rescan
+    rescanTimer->start();
+}
+
+void MainWindow::rescanChangedDirectories()
+{
+    for (int side = 0; side < 2; ++side) {
+        if (!rescanPending[side]) {
+            continue;
         }
+
+        // Wait for a running scan of the same directory to finish first
+        ImageScanner* scanner = side == 0 ? positiveScanner : negativeScanner;
+        if (scanner->isRunning()) {
+            rescanTimer->start();
+            continue;
+        }
+
+        rescanPending[side] = false;
+        rescanning[side] = true;
+        rescannedImages[side].clear();
+        scanner->start(side == 0 ? positiveDir : negativeDir);
     }
+    updateDatasetButtons();
+}
+
+void MainWindow::updateDatasetButtons()
+{
+    // The scanned lists are handed to the worker in place of a rescan, so
+    // wait until they are complete
+    const bool positivesReady = !positiveImages.isEmpty() && !positiveScanner->isRunning();
+    const bool negativesReady = !negativeImages.isEmpty() && !negativeScanner->isRunning();
+
+    ui->btnTrain->setEnabled(!workerBusy && positivesReady && !negativeScanner->isRunning());
+    resumeButton->setEnabled(ui->btnTrain->isEnabled());
+    ui->btnEvaluate->setEnabled(!workerBusy && positivesReady && negativesReady);
 }
 
 void MainWindow::updateCurrentImage()
@@ -166,45 +384,58 @@ void MainWindow::updateCurrentImage()
     }
 
     // Get current image path
-    QString imagePath;
-    if (isCurrentImagePositive) {
-        imagePath = positiveImages.at(currentImageIndex);
-    } else {
-        imagePath = negativeImages.at(currentImageIndex);
+    const QStringList& imageList = isCurrentImagePositive ? positiveImages : negativeImages;
+    QString imagePath = imageList.at(currentImageIndex);
+
+    // Load image; neighbours are usually cached already
+    thumbnailCache.setDisplaySize(QSize(ui->lblCurrentImage->width(), ui->lblCurrentImage->height()));
+    ThumbnailCache::Entry entry;
+    bool loaded = thumbnailCache.get(imagePath, entry);
+
+    // Decode the images on either side in the background, nearest first
+    QStringList neighbours;
+    for (int offset = 1; offset <= PREFETCH_RADIUS; ++offset) {
+        if (currentImageIndex + offset < imageList.size()) {
+            neighbours.append(imageList.at(currentImageIndex + offset));
+        }
+        if (currentImageIndex - offset >= 0) {
+            neighbours.append(imageList.at(currentImageIndex - offset));
+        }
     }
+    thumbnailCache.prefetch(neighbours);
 
-    // Load image
-    QImageReader reader(imagePath);
-    currentImage = reader.read();
-
-    if (currentImage.isNull()) {
+    if (!loaded) {
+        currentImage = QImage();
         ui->lblCurrentImage->setText("Failed to load image");
         ui->lblCurrentImage->setPixmap(QPixmap());
         ui->lblPrediction->setText("No prediction");
         return;
     }
 
+    // The prediction and visualizations only need the network input
+    currentImage = entry.input;
+
     // Display image
-    QPixmap pixmap = QPixmap::fromImage(currentImage.scaled(ui->lblCurrentImage->width(),
-                                                           ui->lblCurrentImage->height(),
-                                                           Qt::KeepAspectRatio,
-                                                           Qt::SmoothTransformation));
-    ui->lblCurrentImage->setPixmap(pixmap);
+    ui->lblCurrentImage->setPixmap(QPixmap::fromImage(entry.display));
     ui->lblCurrentImage->setText("");
 
     // Update image info
     QFileInfo fileInfo(imagePath);
     QString imageInfo = QString("%1 (%2x%3) - %4")
                             .arg(fileInfo.fileName())
-                            .arg(currentImage.width())
-                            .arg(currentImage.height())
+                            .arg(entry.originalSize.width())
+                            .arg(entry.originalSize.height())
                             .arg(isCurrentImagePositive ? "Positive" : "Negative");
     ui->lblImageInfo->setText(imageInfo);
 
-    // Make prediction
+    // Make prediction; the weights are being updated while training runs, so
+    // the prediction waits for it to finish
     try {
-        if (mlp) {
-            float prediction = mlp->predict(currentImage);
+        if (modelTraining) {
+            inferenceContext = MLP::InferenceContext();
+            ui->lblPrediction->setText("Prediction available after training");
+        } else if (mlp) {
+            float prediction = mlp->predict(currentImage, inferenceContext);
             QString predictionText = QString("Prediction: %1 (Threshold: 0.5)")
                                     .arg(prediction, 0, 'f', 4);
             ui->lblPrediction->setText(predictionText);
@@ -295,10 +526,15 @@ void MainWindow::updateHiddenLayerVisualization()
         return;
     }
 
+    if (modelTraining) {
+        hiddenLayerScene->addText("Activations available after training");
+        return;
+    }
+
     try {
         // Get hidden layer activations
-        Eigen::VectorXf input = mlp->preprocessImage(currentImage);
-        mlp->forward(input);
+        Eigen::VectorXf input = MLP::preprocessImage(currentImage);
+        mlp->infer(input, inferenceContext);
 
         // Get number of hidden layers
         int numHiddenLayers = mlp->getNumHiddenLayers();
@@ -354,7 +590,11 @@ void MainWindow::updateHiddenLayerVisualization()
         }
 
         const Layer& hiddenLayer = mlp->getLayers()[layerIdx];
-        const Eigen::VectorXf& activations = hiddenLayer.getLastOutput();
+        if (inferenceContext.outputs.size() != mlp->getLayers().size()) {
+            hiddenLayerScene->addText("No activations available for this layer");
+            return;
+        }
+        const Eigen::VectorXf& activations = inferenceContext.outputs[layerIdx];
 
         if (activations.size() == 0) {
             // No activations available
@@ -554,14 +794,17 @@ void MainWindow::updateOutputLayerVisualization()
             return; // Safety check
         }
 
-        if (currentImage.isNull() || !mlp || mlp->getLayers().empty()) {
+        if (currentImage.isNull() || !mlp || modelTraining || mlp->getLayers().empty()) {
             return;
         }
 
-        // Get output layer (last layer in the network)
-        const Layer& outputLayer = mlp->getLayers().back();
-        const Eigen::VectorXf& output = outputLayer.getLastOutput();
-        const Eigen::VectorXf& z = outputLayer.getLastZ();
+        // Output of the last inference on the current image
+        if (inferenceContext.outputs.size() != mlp->getLayers().size()) {
+            outputLayerScene->addText("No output available");
+            return;
+        }
+        const Eigen::VectorXf& output = inferenceContext.outputs.back();
+        const Eigen::VectorXf& z = inferenceContext.preActivations.back();
 
         // Safety check for output size
         if (output.size() == 0 || z.size() == 0) {
@@ -658,21 +901,9 @@ void MainWindow::on_btnLoadPositive_clicked()
     positiveDir = dir;
     ui->lblPositiveDir->setText(dir);
 
-    // Load images from directory
-    loadImagesFromDir(dir, positiveImages);
-
-    // Update UI
-    ui->btnTrain->setEnabled(!positiveImages.isEmpty());
-    ui->btnEvaluate->setEnabled(!positiveImages.isEmpty() && !negativeImages.isEmpty());
-
-    // Set current image to first positive image
-    if (!positiveImages.isEmpty()) {
-        currentImageIndex = 0;
-        isCurrentImagePositive = true;
-        ui->btnNextImage->setEnabled(positiveImages.size() > 1);
-        ui->btnPrevImage->setEnabled(false);
-        updateCurrentImage();
-    }
+    // Scan the directory in the background; the first image found becomes
+    // the current image
+    startImageScan(true, dir);
 }
 
 void MainWindow::on_btnLoadNegative_clicked()
@@ -688,20 +919,9 @@ void MainWindow::on_btnLoadNegative_clicked()
     negativeDir = dir;
     ui->lblNegativeDir->setText(dir);
 
-    // Load images from directory
-    loadImagesFromDir(dir, negativeImages);
-
-    // Update UI
-    ui->btnEvaluate->setEnabled(!positiveImages.isEmpty() && !negativeImages.isEmpty());
-
-    // If no current image, set to first negative image
-    if (currentImageIndex < 0 && !negativeImages.isEmpty()) {
-        currentImageIndex = 0;
-        isCurrentImagePositive = false;
-        ui->btnNextImage->setEnabled(negativeImages.size() > 1);
-        ui->btnPrevImage->setEnabled(false);
-        updateCurrentImage();
-    }
+    // Scan the directory in the background; its first image is shown if no
+    // image is shown yet
+    startImageScan(false, dir);
 }
 
 void MainWindow::on_btnNextImage_clicked()
@@ -883,26 +1103,23 @@ void MainWindow::onHiddenLayerValueChanged(int value)
     }
 }
 
+QString MainWindow::checkpointPath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/checkpoint.senm";
+}
+
 void MainWindow::createMLPFromUIConfig()
 {
     // Get the activation function
     QString hiddenActivation = ui->cbHiddenActivation->currentText();
 
     // Create a new MLP with the configured hidden layers
-    delete mlp;
-    mlp = new MLP(512 * 512, hiddenLayerSizes, 1, hiddenActivation.toStdString(), "sigmoid");
+    mlp = std::make_shared<MLP>(512 * 512, hiddenLayerSizes, 1, hiddenActivation.toStdString(), "sigmoid");
 
-    // Update worker
+    // Point the worker at the new model; keeping the worker keeps its
+    // ingested dataset, so only changed files are processed on retrain
     worker->stop();
-    delete worker;
-    worker = new TrainingWorker(mlp);
-    worker->moveToThread(&workerThread);
-
-    // Connect signals and slots using Qt6 syntax
-    connect(worker, SIGNAL(progressUpdated(int, int, float)), this, SLOT(onTrainingProgressUpdated(int, int, float)));
-    connect(worker, SIGNAL(epochCompleted(int, float, float)), this, SLOT(onEpochCompleted(int, float, float)));
-    connect(worker, SIGNAL(trainingComplete(float)), this, SLOT(onTrainingComplete(float)));
-    connect(worker, SIGNAL(evaluationComplete(float, int, int, int, int)), this, SLOT(onEvaluationComplete(float, int, int, int, int)));
+    worker->setMLP(mlp.get());
 }
 
 void MainWindow::on_btnTrain_clicked()
@@ -910,16 +1127,71 @@ void MainWindow::on_btnTrain_clicked()
     // Create a new MLP with the current configuration
     createMLPFromUIConfig();
 
-    // Set training parameters
+    startTraining(QString());
+}
+
+void MainWindow::onResumeTrainingClicked()
+{
+    MLP::ModelInfo info;
+    if (!MLP::inspectFile(checkpointPath(), info) || info.trainingState.isEmpty()) {
+        QMessageBox::information(this, "Resume Training",
+                                 "There is no checkpoint to resume from. Set \"Checkpoint Every\" before training "
+                                 "to save one.");
+        return;
+    }
+    if (info.inputSize != 512 * 512 || info.outputSize != 1) {
+        QMessageBox::critical(this, "Resume Training", "The checkpoint does not fit the current input and output sizes.");
+        return;
+    }
+
+    // Show the settings of the run being continued; the worker takes them
+    // from the checkpoint itself
+    const QJsonObject state = info.trainingState;
+    ui->sbLearningRate->setValue(state["learning_rate"].toDouble());
+    ui->sbEpochs->setValue(state["epochs"].toInt());
+    ui->sbBatchSize->setValue(state["batch_size"].toInt());
+    ui->cbShuffle->setChecked(state["shuffle"].toBool());
+    augmentCheckBox->setChecked(state["augmentation"].toObject()["enabled"].toBool());
+
+    // The worker loads the checkpoint's weights and architecture into the
+    // current model
+    worker->stop();
+    worker->setMLP(mlp.get());
+    resumingTraining = true;
+    startTraining(checkpointPath());
+}
+
+void MainWindow::startTraining(const QString& resumeFile)
+{
+    // Set training parameters; the scanned lists spare the worker a rescan,
+    // and the directory watcher keeps them up to date
     worker->setPositiveDir(positiveDir);
     worker->setNegativeDir(negativeDir);
+    worker->setPositiveFiles(positiveImages);
+    worker->setNegativeFiles(negativeImages);
     worker->setLearningRate(ui->sbLearningRate->value());
     worker->setEpochs(ui->sbEpochs->value());
     worker->setBatchSize(ui->sbBatchSize->value());
     worker->setShuffle(ui->cbShuffle->isChecked());
 
+    AugmentationOptions augmentation;
+    augmentation.enabled = augmentCheckBox->isChecked();
+    worker->setAugmentation(augmentation);
+
+    CheckpointOptions checkpoint;
+    if (checkpointSpinBox->value() > 0) {
+        checkpoint.filePath = checkpointPath();
+        checkpoint.intervalMinutes = checkpointSpinBox->value();
+        QDir().mkpath(QFileInfo(checkpoint.filePath).absolutePath());
+    }
+    worker->setCheckpoint(checkpoint);
+    worker->setResumeFile(resumeFile);
+
     // Disable UI elements during training
+    workerBusy = true;
+    modelTraining = true;
     ui->btnTrain->setEnabled(false);
+    resumeButton->setEnabled(false);
     ui->btnEvaluate->setEnabled(false);
     ui->btnExportModel->setEnabled(false);
     ui->btnImportModel->setEnabled(false);
@@ -936,7 +1208,9 @@ void MainWindow::on_btnTrain_clicked()
 void MainWindow::on_btnEvaluate_clicked()
 {
     // Disable UI elements during evaluation
+    workerBusy = true;
     ui->btnTrain->setEnabled(false);
+    resumeButton->setEnabled(false);
     ui->btnEvaluate->setEnabled(false);
     ui->btnExportModel->setEnabled(false);
     ui->btnImportModel->setEnabled(false);
@@ -944,11 +1218,31 @@ void MainWindow::on_btnEvaluate_clicked()
     // Set evaluation parameters
     worker->setPositiveDir(positiveDir);
     worker->setNegativeDir(negativeDir);
+    worker->setPositiveFiles(positiveImages);
+    worker->setNegativeFiles(negativeImages);
 
     // Start evaluation
     QMetaObject::invokeMethod(worker, "evaluate", Qt::QueuedConnection);
 }
 
+void MainWindow::onScreeningCascadeClicked()
+{
+    // The button toggles between choosing a cascade and evaluating without one
+    if (!screeningCascade.isEmpty()) {
+        screeningCascade.clear();
+    } else {
+        screeningCascade = QFileDialog::getOpenFileName(this, "Choose Screening Cascade",
+                                                        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
+                                                        "Cascade Files (*.json)");
+    }
+
+    worker->setScreeningCascade(screeningCascade);
+    screeningButton->setText(screeningCascade.isEmpty() ? "Evaluate With Screening..." : "Evaluate Without Screening");
+    if (!screeningCascade.isEmpty()) {
+        statusBar()->showMessage("Evaluation will screen images with " + QFileInfo(screeningCascade).fileName(), 5000);
+    }
+}
+
 void MainWindow::on_btnExportModel_clicked()
 {
     QString filePath = QFileDialog::getSaveFileName(this, "Export Model",
@@ -959,40 +1253,21 @@ void MainWindow::on_btnExportModel_clicked()
         return;
     }
 
-    bool success = false;
-
-    // Check which format was selected based on the file extension
-    if (filePath.endsWith(".senm", Qt::CaseInsensitive)) {
-        // Save model to binary format
-        success = mlp->saveToBinary(filePath);
+    // Add .json extension if not present
+    if (!filePath.endsWith(".senm", Qt::CaseInsensitive) && !filePath.endsWith(".json", Qt::CaseInsensitive)) {
+        filePath += ".json";
+    }
 
-        if (success) {
-            QMessageBox::information(this, "Export Successful", "Model exported successfully in binary format.");
-        } else {
-            QMessageBox::critical(this, "Export Failed", "Failed to write model to binary file.");
-        }
-    } else {
-        // Add .json extension if not present
-        if (!filePath.endsWith(".json", Qt::CaseInsensitive)) {
-            filePath += ".json";
-        }
+    // Large models take a while to write, so the worker does it
+    workerBusy = true;
+    ui->btnTrain->setEnabled(false);
+    resumeButton->setEnabled(false);
+    ui->btnEvaluate->setEnabled(false);
+    ui->btnExportModel->setEnabled(false);
+    ui->btnImportModel->setEnabled(false);
+    statusBar()->showMessage("Exporting model...");
 
-        // Save model to JSON
-        QJsonObject json = mlp->saveToJson();
-        QJsonDocument doc(json);
-        QByteArray jsonData = doc.toJson(QJsonDocument::Indented);
-
-        // Write to file
-        QFile file(filePath);
-        if (file.open(QIODevice::WriteOnly)) {
-            file.write(jsonData);
-            file.close();
-            QMessageBox::information(this, "Export Successful", "Model exported successfully in JSON format.");
-            success = true;
-        } else {
-            QMessageBox::critical(this, "Export Failed", "Failed to write model to JSON file.");
-        }
-    }
+    QMetaObject::invokeMethod(worker, "exportModel", Qt::QueuedConnection, Q_ARG(QString, filePath));
 }
 
 void MainWindow::on_btnImportModel_clicked()
@@ -1005,89 +1280,92 @@ void MainWindow::on_btnImportModel_clicked()
         return;
     }
 
-    bool success = false;
-
-    // Check file extension to determine format
-    if (filePath.endsWith(".senm", Qt::CaseInsensitive)) {
-        // Load model from binary format
-        success = mlp->loadFromBinary(filePath);
-
-        if (success) {
-            QMessageBox::information(this, "Import Successful", "Model imported successfully from binary format.");
-
-            // Update UI with the loaded model's configuration
-            hiddenLayerSizes = mlp->getHiddenLayerSizes();
-            updateHiddenLayersUIFromModel();
+    // The worker loads into a new model; the current one stays in use until
+    // the import succeeds
+    workerBusy = true;
+    ui->btnTrain->setEnabled(false);
+    resumeButton->setEnabled(false);
+    ui->btnEvaluate->setEnabled(false);
+    ui->btnExportModel->setEnabled(false);
+    ui->btnImportModel->setEnabled(false);
+    statusBar()->showMessage("Importing model...");
 
-            // Update the hidden layer selector in the visualization tab
-            if (hiddenLayerSelector) {
-                hiddenLayerSelector->clear();
-                for (size_t i = 0; i < hiddenLayerSizes.size(); ++i) {
-                    hiddenLayerSelector->addItem(QString("Hidden Layer %1").arg(i + 1));
-                }
-            }
+    QMetaObject::invokeMethod(worker, "importModel", Qt::QueuedConnection, Q_ARG(QString, filePath));
+}
 
-            // Set activation function
-            if (mlp->getNumHiddenLayers() > 0) {
-                ui->cbHiddenActivation->setCurrentText(QString::fromStdString(mlp->getLayers()[0].getActivationFunction()));
-            }
+void MainWindow::onModelExported(const QString& filePath, bool success)
+{
+    // Update UI
+    workerBusy = false;
+    updateDatasetButtons();
+    ui->btnExportModel->setEnabled(true);
+    ui->btnImportModel->setEnabled(true);
+    statusBar()->clearMessage();
 
-            // Update current image if available
-            if (!currentImage.isNull()) {
-                updateCurrentImage();
-            }
-        } else {
-            QMessageBox::critical(this, "Import Failed", "Failed to load model from binary file. The file may be corrupted or incompatible.");
-        }
+    const bool binary = filePath.endsWith(".senm", Qt::CaseInsensitive);
+    if (success) {
+        QMessageBox::information(this, "Export Successful",
+                                 binary ? "Model exported successfully in binary format."
+                                        : "Model exported successfully in JSON format.");
     } else {
-        // Assume JSON format
-        // Read JSON file
-        QFile file(filePath);
-        if (!file.open(QIODevice::ReadOnly)) {
-            QMessageBox::critical(this, "Import Failed", "Failed to open model file.");
-            return;
-        }
-
-        QByteArray jsonData = file.readAll();
-        file.close();
+        QMessageBox::critical(this, "Export Failed",
+                              binary ? "Failed to write model to binary file."
+                                     : "Failed to write model to JSON file.");
+    }
+}
 
-        QJsonDocument doc = QJsonDocument::fromJson(jsonData);
-        if (doc.isNull() || !doc.isObject()) {
-            QMessageBox::critical(this, "Import Failed", "Invalid JSON format.");
-            return;
-        }
+void MainWindow::onModelImported(const QString& filePath, std::shared_ptr<MLP> model)
+{
+    // Update UI
+    workerBusy = false;
+    updateDatasetButtons();
+    ui->btnExportModel->setEnabled(true);
+    ui->btnImportModel->setEnabled(true);
+    statusBar()->clearMessage();
 
-        // Load model from JSON
-        if (mlp->loadFromJson(doc.object())) {
-            QMessageBox::information(this, "Import Successful", "Model imported successfully from JSON format.");
+    const bool binary = filePath.endsWith(".senm", Qt::CaseInsensitive);
+    if (!model) {
+        QMessageBox::critical(this, "Import Failed",
+                              binary ? "Failed to load model from binary file. The file may be corrupted or incompatible."
+                                     : "Failed to load model from JSON file. The model architecture may be incompatible.");
+        return;
+    }
 
-            // Update UI with the loaded model's configuration
-            hiddenLayerSizes = mlp->getHiddenLayerSizes();
-            updateHiddenLayersUIFromModel();
+    // Switch to the loaded model; the worker is idle, having just finished
+    // the import
+    worker->setMLP(model.get());
+    mlp = std::move(model);
 
-            // Update the hidden layer selector in the visualization tab
-            if (hiddenLayerSelector) {
-                hiddenLayerSelector->clear();
-                for (size_t i = 0; i < hiddenLayerSizes.size(); ++i) {
-                    hiddenLayerSelector->addItem(QString("Hidden Layer %1").arg(i + 1));
-                }
-            }
+    QMessageBox::information(this, "Import Successful",
+                             binary ? "Model imported successfully from binary format."
+                                    : "Model imported successfully from JSON format.");
 
-            // Set activation function
-            if (mlp->getNumHiddenLayers() > 0) {
-                ui->cbHiddenActivation->setCurrentText(QString::fromStdString(mlp->getLayers()[0].getActivationFunction()));
-            }
+    updateUIFromModel();
+}
 
-            // Update current image if available
-            if (!currentImage.isNull()) {
-                updateCurrentImage();
-            }
+void MainWindow::updateUIFromModel()
+{
+    // Update UI with the model's configuration
+    hiddenLayerSizes = mlp->getHiddenLayerSizes();
+    updateHiddenLayersUIFromModel();
 
-            success = true;
-        } else {
-            QMessageBox::critical(this, "Import Failed", "Failed to load model from JSON file. The model architecture may be incompatible.");
+    // Update the hidden layer selector in the visualization tab
+    if (hiddenLayerSelector) {
+        hiddenLayerSelector->clear();
+        for (size_t i = 0; i < hiddenLayerSizes.size(); ++i) {
+            hiddenLayerSelector->addItem(QString("Hidden Layer %1").arg(i + 1));
         }
     }
+
+    // Set activation function
+    if (mlp->getNumHiddenLayers() > 0) {
+        ui->cbHiddenActivation->setCurrentText(QString::fromStdString(mlp->getLayers()[0].getActivationFunction()));
+    }
+
+    // Update current image if available
+    if (!currentImage.isNull()) {
+        updateCurrentImage();
+    }
 }
 
 void MainWindow::onTrainingProgressUpdated(int epoch, int totalEpochs, float loss)
@@ -1108,12 +1386,19 @@ void MainWindow::onEpochCompleted(int epoch, float loss, float validationLoss)
 void MainWindow::onTrainingComplete(float finalLoss)
 {
     // Update UI
-    ui->btnTrain->setEnabled(true);
-    ui->btnEvaluate->setEnabled(!positiveImages.isEmpty() && !negativeImages.isEmpty());
+    workerBusy = false;
+    modelTraining = false;
+    updateDatasetButtons();
     ui->btnExportModel->setEnabled(true);
     ui->btnImportModel->setEnabled(true);
     ui->progressBar->setVisible(false);
 
+    // A resumed run may have changed the architecture to the checkpoint's
+    if (resumingTraining) {
+        resumingTraining = false;
+        updateUIFromModel();
+    }
+
     // Update status bar
     statusBar()->showMessage(QString("Training complete. Final loss: %1").arg(finalLoss, 0, 'f', 6), 5000);
 
@@ -1123,14 +1408,32 @@ void MainWindow::onTrainingComplete(float finalLoss)
     }
 }
 
+void MainWindow::onTrainingFailed(const QString& reason)
+{
+    // trainingComplete follows and restores the UI
+    QMessageBox::warning(this, "Training Failed", reason);
+}
+
+void MainWindow::onScreeningComplete(int escalated, int scored, qint64 milliseconds)
+{
+    // Shown with the evaluation results that follow
+    screeningSummary = QString("\nFull Model Used: %1 of %2 (%3 ms)").arg(escalated).arg(scored).arg(milliseconds);
+}
+
 void MainWindow::onEvaluationComplete(float accuracy, int truePositives, int trueNegatives, int falsePositives, int falseNegatives)
 {
     // Update UI
-    ui->btnTrain->setEnabled(true);
-    ui->btnEvaluate->setEnabled(true);
+    workerBusy = false;
+    updateDatasetButtons();
     ui->btnExportModel->setEnabled(true);
     ui->btnImportModel->setEnabled(true);
 
+    // Nothing was scored if evaluation failed; the failure has been shown
+    if (truePositives + trueNegatives + falsePositives + falseNegatives == 0) {
+        screeningSummary.clear();
+        return;
+    }
+
     // Update accuracy label
     QString accuracyText = QString("Accuracy: %1%\nTrue Positives: %2\nTrue Negatives: %3\nFalse Positives: %4\nFalse Negatives: %5")
                               .arg(accuracy * 100.0, 0, 'f', 2)
@@ -1138,12 +1441,20 @@ void MainWindow::onEvaluationComplete(float accuracy, int truePositives, int tru
                               .arg(trueNegatives)
                               .arg(falsePositives)
                               .arg(falseNegatives);
-    ui->lblAccuracy->setText(accuracyText);
+    ui->lblAccuracy->setText(accuracyText + screeningSummary);
+    screeningSummary.clear();
 
     // Update status bar
     statusBar()->showMessage(QString("Evaluation complete. Accuracy: %1%").arg(accuracy * 100.0, 0, 'f', 2), 5000);
 }
 
+void MainWindow::onEvaluationFailed(const QString& reason)
+{
+    // evaluationComplete follows and restores the UI
+    ui->lblAccuracy->setText("Evaluation failed");
+    QMessageBox::warning(this, "Evaluation Failed", reason);
+}
+
 void MainWindow::onTabChanged(int index)
 {
     // Update visualizations when switching to visualization tabs
@@ -13,12 +13,16 @@
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
 #include <QTimer>
+#include <QFileSystemWatcher>
 #include <QListWidget>
 #include <QSpinBox>
 #include <QComboBox>
+#include <QCheckBox>
 
 #include "mlp.h"
 #include "trainingworker.h"
+#include "imagescanner.h"
+#include "thumbnailcache.h"
 #include "losscurvewidget.h"
 
 QT_BEGIN_NAMESPACE
@@ -42,7 +46,9 @@ private slots:
     void on_btnNextImage_clicked();
     void on_btnPrevImage_clicked();
     void on_btnTrain_clicked();
+    void onResumeTrainingClicked();
     void on_btnEvaluate_clicked();
+    void onScreeningCascadeClicked();
     void on_btnExportModel_clicked();
     void on_btnImportModel_clicked();
 
@@ -50,7 +56,12 @@ private slots:
     void onTrainingProgressUpdated(int epoch, int totalEpochs, float loss);
     void onEpochCompleted(int epoch, float loss, float validationLoss);
     void onTrainingComplete(float finalLoss);
+    void onTrainingFailed(const QString& reason);
+    void onScreeningComplete(int escalated, int scored, qint64 milliseconds);
     void onEvaluationComplete(float accuracy, int truePositives, int trueNegatives, int falsePositives, int falseNegatives);
+    void onEvaluationFailed(const QString& reason);
+    void onModelExported(const QString& filePath, bool success);
+    void onModelImported(const QString& filePath, std::shared_ptr<MLP> model);
 
     // Tab changed
     void onTabChanged(int index);
@@ -65,11 +76,35 @@ private:
     Ui::MainWindow *ui;
 
     // MLP
-    MLP* mlp;
+    std::shared_ptr<MLP> mlp;
+
+    // Activations of the last prediction on the current image, kept apart
+    // from the layers so that predicting does not modify the model
+    MLP::InferenceContext inferenceContext;
 
     // Training worker
     QThread workerThread;
     TrainingWorker* worker;
+    bool workerBusy;
+
+    // Whether the worker is changing the model's weights, during which the
+    // model is not used for predictions
+    bool modelTraining;
+
+    // Background directory scanners
+    ImageScanner* positiveScanner;
+    ImageScanner* negativeScanner;
+
+    // Watches the example directories and the subdirectories holding their
+    // images; changed directories are rescanned in the background once they
+    // settle, and the lists replaced when the rescan finishes. Index 0 is
+    // the positive side, 1 the negative side.
+    QFileSystemWatcher* directoryWatcher;
+    QTimer* rescanTimer;
+    bool rescanPending[2];
+    bool rescanning[2];
+    QStringList rescannedImages[2];
+    static const int RESCAN_DELAY_MS = 2000;
 
     // Image data
     QString positiveDir;
@@ -77,9 +112,13 @@ private:
     QStringList positiveImages;
     QStringList negativeImages;
     int currentImageIndex;
-    QImage currentImage;
+    QImage currentImage;            // network input of the current image
     bool isCurrentImagePositive;
 
+    // Decoded images around the current one
+    ThumbnailCache thumbnailCache;
+    static const int PREFETCH_RADIUS = 4;
+
     // Graphics scenes for visualization
     QGraphicsScene* inputLayerScene;
     QGraphicsScene* hiddenLayerScene;
@@ -94,6 +133,21 @@ private:
     QPushButton* removeHiddenLayerButton;
     std::vector<int> hiddenLayerSizes;
 
+    // Data augmentation toggle
+    QCheckBox* augmentCheckBox;
+
+    // Checkpoint interval in minutes, 0 for none
+    QSpinBox* checkpointSpinBox;
+
+    // Continues training from the checkpoint
+    QPushButton* resumeButton;
+    bool resumingTraining;
+
+    // Cascade file whose screening model runs before the model during evaluation
+    QPushButton* screeningButton;
+    QString screeningCascade;
+    QString screeningSummary;
+
     // Hidden layer visualization selector
     QComboBox* hiddenLayerSelector;
     int currentHiddenLayerIndex;
@@ -110,8 +164,35 @@ private:
     // Create MLP from UI configuration
     void createMLPFromUIConfig();
 
-    // Load images from directory
-    void loadImagesFromDir(const QString& dir, QStringList& imageList);
+    // File that training checkpoints are written to
+    QString checkpointPath() const;
+
+    // Start training the current model, continuing from a checkpoint if one is given
+    void startTraining(const QString& resumeFile);
+
+    // Show the architecture of the current model in the UI
+    void updateUIFromModel();
+
+    // Start scanning a directory of positive or negative examples
+    void startImageScan(bool positive, const QString& dir);
+
+    // Append a batch of scanned images to the positive or negative list
+    void onImagesScanned(bool positive, const QStringList& filePaths);
+
+    // Report a finished scan, swapping in the list rebuilt by a rescan
+    void onImageScanFinished(bool positive, int count);
+
+    // Watch the directories holding a batch of scanned images
+    void watchDirectories(const QStringList& filePaths);
+
+    // Queue a rescan of the example directory a changed directory belongs to
+    void onDirectoryChanged(const QString& path);
+
+    // Rescan the example directories that changed
+    void rescanChangedDirectories();
+
+    // Enable the train and evaluate buttons once the image lists are complete
+    void updateDatasetButtons();
 
     // Update current image display
     void updateCurrentImage();
@@ -1,39 +1,344 @@
 #include "mlp.h"
+#include "jsonstream.h"
+#include "crc32c.h"
 #include <cmath>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QSaveFile>
+#include <QDebug>
+#include <QtEndian>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Size of the magic number, format version and metadata length that precede
+// the metadata of a binary model file
+const qint64 BINARY_HEADER_SIZE = 9;
+
+// Alignment of the weight and bias blocks in version 3 files, enough for
+// any SIMD load and a divisor of the page size
+const int BLOCK_ALIGNMENT = 64;
+
+// Largest block passed to a single readRawData/writeRawData call, which take
+// an int length
+const qint64 MAX_RAW_BLOCK_FLOATS = (1 << 30) / sizeof(float);
+
+/**
+ * @brief Write floats to a stream as one little-endian block
+ * @param stream Stream to write to
+ * @param data Values to write
+ * @param count Number of values
+ * @return True if successful, false otherwise
+ */
+bool writeFloats(QDataStream& stream, const float* data, qint64 count)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Swap a bounded chunk at a time; the model itself is left untouched
+    std::vector<float> swapped(static_cast<size_t>(std::min(count, MAX_RAW_BLOCK_FLOATS)));
+#endif
+    while (count > 0) {
+        const qint64 chunk = std::min(count, MAX_RAW_BLOCK_FLOATS);
+        const int bytes = static_cast<int>(chunk * sizeof(float));
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        qToLittleEndian<float>(data, chunk, swapped.data());
+        if (stream.writeRawData(reinterpret_cast<const char*>(swapped.data()), bytes) != bytes) {
+            return false;
+        }
+#else
+        if (stream.writeRawData(reinterpret_cast<const char*>(data), bytes) != bytes) {
+            return false;
+        }
+#endif
+        data += chunk;
+        count -= chunk;
+    }
+    return true;
+}
+
+/**
+ * @brief Read a little-endian block of floats from a stream
+ * @param stream Stream to read from
+ * @param data Destination, written in place
+ * @param count Number of values
+ * @return True if successful, false otherwise
+ */
+bool readFloats(QDataStream& stream, float* data, qint64 count)
+{
+    while (count > 0) {
+        const qint64 chunk = std::min(count, MAX_RAW_BLOCK_FLOATS);
+        const int bytes = static_cast<int>(chunk * sizeof(float));
+        if (stream.readRawData(reinterpret_cast<char*>(data), bytes) != bytes) {
+            return false;
+        }
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        qFromLittleEndian<float>(data, chunk, data);
+#endif
+        data += chunk;
+        count -= chunk;
+    }
+    return true;
+}
+
+// Number of floats compressed together in compressed version 3 files, and
+// covered by one checksum; each chunk is compressed and checked
+// independently so chunks can be processed in parallel. Files record the
+// chunk size they were written with, so readers take it from the metadata
+const qint64 COMPRESSION_CHUNK_FLOATS = 1 << 20;
+
+/**
+ * @brief Split a block of floats into compression and checksum chunks
+ * @param chunks Chunk list to append (data, count) pairs to
+ * @param data First float of the block
+ * @param count Number of floats in the block
+ * @param chunkFloats Number of floats per chunk, at least one
+ */
+template<typename T>
+void appendChunks(std::vector<std::pair<T*, qint64>>& chunks, T* data, qint64 count, qint64 chunkFloats)
+{
+    for (qint64 start = 0; start < count; start += chunkFloats) {
+        chunks.emplace_back(data + start, std::min(chunkFloats, count - start));
+    }
+}
+
+/**
+ * @brief Checksum a chunk of floats as stored in a binary model file
+ * @param data Floats to checksum
+ * @param count Number of floats
+ * @return CRC-32C of the little-endian bytes of the floats
+ */
+quint32 chunkChecksum(const float* data, qint64 count)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    std::vector<float> swapped(static_cast<size_t>(count));
+    qToLittleEndian<float>(data, count, swapped.data());
+    data = swapped.data();
+#endif
+    return crc32c(data, static_cast<size_t>(count) * sizeof(float));
+}
+
+/**
+ * @brief Checksum every chunk in parallel
+ * @param chunks Chunks as split by appendChunks
+ * @return Checksum of each chunk
+ */
+std::vector<quint32> chunkChecksums(const std::vector<std::pair<const float*, qint64>>& chunks)
+{
+    std::vector<quint32> checksums(chunks.size());
+    QThreadPool pool;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        pool.start([&chunks, &checksums, i]() {
+            checksums[i] = chunkChecksum(chunks[i].first, chunks[i].second);
+        });
+    }
+    pool.waitForDone();
+    return checksums;
+}
+
+/**
+ * @brief Byte-shuffle and compress a chunk of floats
+ *
+ * The first bytes of all floats are stored together, then the second bytes
+ * and so on. Exponent bytes of neighbouring weights are similar, so the
+ * shuffled data compresses noticeably better than the floats themselves.
+ *
+ * @param data Floats to compress
+ * @param count Number of floats
+ * @param level zlib compression level
+ * @return Compressed data as produced by qCompress
+ */
+QByteArray compressChunk(const float* data, qint64 count, int level)
+{
+    const uchar* bytes = reinterpret_cast<const uchar*>(data);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    std::vector<float> swapped(static_cast<size_t>(count));
+    qToLittleEndian<float>(data, count, swapped.data());
+    bytes = reinterpret_cast<const uchar*>(swapped.data());
+#endif
+
+    QByteArray shuffled(static_cast<qsizetype>(count * sizeof(float)), Qt::Uninitialized);
+    uchar* out = reinterpret_cast<uchar*>(shuffled.data());
+    for (size_t byte = 0; byte < sizeof(float); ++byte) {
+        uchar* plane = out + byte * count;
+        for (qint64 i = 0; i < count; ++i) {
+            plane[i] = bytes[i * sizeof(float) + byte];
+        }
+    }
+
+    return qCompress(shuffled, level);
+}
+
+/**
+ * @brief Decompress and unshuffle a chunk written by compressChunk
+ * @param source Compressed data
+ * @param size Size of the compressed data in bytes
+ * @param data Destination floats
+ * @param count Number of floats expected
+ * @return True if successful, false otherwise
+ */
+bool decompressChunk(const uchar* source, qint64 size, float* data, qint64 count)
+{
+    QByteArray shuffled = qUncompress(source, static_cast<qsizetype>(size));
+    if (shuffled.size() != static_cast<qsizetype>(count * sizeof(float))) {
+        return false;
+    }
+
+    const uchar* in = reinterpret_cast<const uchar*>(shuffled.constData());
+    uchar* bytes = reinterpret_cast<uchar*>(data);
+    for (size_t byte = 0; byte < sizeof(float); ++byte) {
+        const uchar* plane = in + byte * count;
+        for (qint64 i = 0; i < count; ++i) {
+            bytes[i * sizeof(float) + byte] = plane[i];
+        }
+    }
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    qFromLittleEndian<float>(data, count, data);
+#endif
+    return true;
+}
+
+/**
+ * @brief Round an offset up to the block alignment of version 3 files
+ * @param offset Offset in bytes
+ * @return Aligned offset
+ */
+qint64 alignedOffset(qint64 offset)
+{
+    return (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+/**
+ * @brief Name of a layer's weights in JSON model files
+ * @param layer Layer index
+ * @param layerCount Number of layers in the network
+ * @return Member name in the "weights" object
+ */
+QString weightsName(size_t layer, size_t layerCount)
+{
+    // A network without hidden layers has always written its only layer as
+    // input_to_hidden1, and existing files depend on that
+    if (layer == 0) {
+        return QString("input_to_hidden1");
+    }
+    if (layer == layerCount - 1) {
+        return QString("hidden%1_to_output").arg(layerCount - 1);
+    }
+    return QString("hidden%1_to_hidden%2").arg(layer).arg(layer + 1);
+}
+
+/**
+ * @brief Name of a layer's biases in JSON model files
+ * @param layer Layer index
+ * @param layerCount Number of layers in the network
+ * @return Member name in the "biases" object
+ */
+QString biasesName(size_t layer, size_t layerCount)
+{
+    return layer == layerCount - 1 ? QString("output") : QString("hidden%1").arg(layer + 1);
+}
+
+/**
+ * @brief Read a JSON array of exactly count numbers
+ * @param reader Reader positioned at the array
+ * @param data Output values
+ * @param count Expected number of values
+ * @return True if successful, false otherwise
+ */
+bool readFloatArray(JsonStreamReader& reader, float* data, qint64 count)
+{
+    if (!reader.beginArray()) {
+        return false;
+    }
+    for (qint64 i = 0; i < count; ++i) {
+        if (!reader.nextElement() || !reader.readFloat(data[i])) {
+            return false;
+        }
+    }
+    return !reader.nextElement() && !reader.hasError();
+}
+
+} // namespace
 
 MLP::MLP(int inputSize, int hiddenSize, int outputSize,
-         const std::string& hiddenActivation, const std::string& outputActivation)
-    : inputSize(inputSize), outputSize(outputSize)
+         const std::string& hiddenActivation, const std::string& outputActivation, quint64 seed)
+    : inputSize(inputSize), outputSize(outputSize), seed(seed)
 {
     // Store hidden layer size
     hiddenSizes = {hiddenSize};
 
     // Create layers
-    layers.push_back(Layer(inputSize, hiddenSize, hiddenActivation));
-    layers.push_back(Layer(hiddenSize, outputSize, outputActivation));
+    layers.push_back(Layer(inputSize, hiddenSize, hiddenActivation, false));
+    layers.push_back(Layer(hiddenSize, outputSize, outputActivation, false));
+    initializeLayers();
 }
 
 MLP::MLP(int inputSize, const std::vector<int>& hiddenSizes, int outputSize,
-         const std::string& hiddenActivation, const std::string& outputActivation)
-    : inputSize(inputSize), hiddenSizes(hiddenSizes), outputSize(outputSize)
+         const std::string& hiddenActivation, const std::string& outputActivation, quint64 seed)
+    : inputSize(inputSize), outputSize(outputSize), hiddenSizes(hiddenSizes), seed(seed)
 {
     if (hiddenSizes.empty()) {
         // If no hidden layers, create a direct input-to-output layer
-        layers.push_back(Layer(inputSize, outputSize, outputActivation));
+        layers.push_back(Layer(inputSize, outputSize, outputActivation, false));
     } else {
         // Create first hidden layer (input to first hidden)
-        layers.push_back(Layer(inputSize, hiddenSizes[0], hiddenActivation));
+        layers.push_back(Layer(inputSize, hiddenSizes[0], hiddenActivation, false));
 
         // Create additional hidden layers
         for (size_t i = 1; i < hiddenSizes.size(); ++i) {
-            layers.push_back(Layer(hiddenSizes[i-1], hiddenSizes[i], hiddenActivation));
+            layers.push_back(Layer(hiddenSizes[i-1], hiddenSizes[i], hiddenActivation, false));
         }
 
         // Create output layer (last hidden to output)
-        layers.push_back(Layer(hiddenSizes.back(), outputSize, outputActivation));
+        layers.push_back(Layer(hiddenSizes.back(), outputSize, outputActivation, false));
+    }
+    initializeLayers();
+}
+
+void MLP::initializeLayers()
+{
+    if (seed == 0) {
+        std::random_device rd;
+        seed = (static_cast<quint64>(rd()) << 32) | rd();
+    }
+
+    // Each layer draws from its own stream of the seed
+    for (size_t i = 0; i < layers.size(); ++i) {
+        layers[i].initializeWeights(seed, static_cast<quint32>(i));
+    }
+}
+
+MLP::MLP()
+    : inputSize(0), outputSize(0), seed(0)
+{
+}
+
+std::unique_ptr<MLP> MLP::fromFile(const QString& filePath, bool map)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    // Binary files start with the magic number; anything else is taken to be JSON
+    uchar header[sizeof(quint32)];
+    const bool binary = file.read(reinterpret_cast<char*>(header), sizeof(header)) == sizeof(header) &&
+                        (qFromLittleEndian<quint32>(header) == MAGIC_NUMBER ||
+                         qFromLittleEndian<quint32>(header) == MAGIC_NUMBER_REVERSED);
+    file.close();
+
+    std::unique_ptr<MLP> model(new MLP());
+    const bool ok = binary ? model->loadBinary(filePath, map) : model->readJsonFile(filePath);
+    if (!ok) {
+        return nullptr;
     }
+
+    return model;
 }
 
 std::vector<int> MLP::getHiddenLayerSizes() const {
@@ -52,6 +357,21 @@ Eigen::VectorXf MLP::forward(const Eigen::VectorXf& input)
     return current;
 }
 
+const Eigen::VectorXf& MLP::infer(const Eigen::VectorXf& input, InferenceContext& context) const
+{
+    context.preActivations.resize(layers.size());
+    context.outputs.resize(layers.size());
+
+    // Each layer reads the previous layer's output in the context
+    const Eigen::VectorXf* current = &input;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        layers[i].infer(*current, context.preActivations[i], context.outputs[i]);
+        current = &context.outputs[i];
+    }
+
+    return *current;
+}
+
 float MLP::train(const Eigen::VectorXf& input, const Eigen::VectorXf& target, float learningRate)
 {
     // Forward pass
@@ -96,46 +416,99 @@ Eigen::VectorXf MLP::calculateLossGradient(const Eigen::VectorXf& output, const
 }
 
 Eigen::VectorXf MLP::preprocessImage(const QImage& image)
+{
+    Eigen::VectorXf input(512 * 512);
+    preprocessImage(image, input);
+    return input;
+}
+
+void MLP::preprocessImage(const QImage& image, Eigen::Ref<Eigen::VectorXf> input)
+{
+    preprocessImage(image, input, 512);
+}
+
+void MLP::preprocessImage(const QImage& image, Eigen::Ref<Eigen::VectorXf> input, int side)
 {
     // Convert to grayscale and resize if necessary
+    QImage processedImage = toInputImage(image, side, side);
+
+    // Convert to vector and normalize
+    for (int y = 0; y < side; ++y) {
+        const uchar* line = processedImage.constScanLine(y);
+        for (int x = 0; x < side; ++x) {
+            // Normalize pixel value to [0, 1]
+            input(y * side + x) = static_cast<float>(line[x]) / 255.0f;
+        }
+    }
+}
+
+int MLP::getInputSide() const
+{
+    const int side = static_cast<int>(std::lround(std::sqrt(static_cast<double>(inputSize))));
+    return side * side == inputSize ? side : 0;
+}
+
+QImage MLP::toInputImage(const QImage& image, int width, int height)
+{
     QImage processedImage = image;
     if (processedImage.format() != QImage::Format_Grayscale8) {
         processedImage = processedImage.convertToFormat(QImage::Format_Grayscale8);
     }
 
-    if (processedImage.width() != 512 || processedImage.height() != 512) {
-        processedImage = processedImage.scaled(512, 512, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-    }
+    if (processedImage.width() != width || processedImage.height() != height) {
+        processedImage = processedImage.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
 
-    // Convert to vector and normalize
-    Eigen::VectorXf input(512 * 512);
-    for (int y = 0; y < 512; ++y) {
-        for (int x = 0; x < 512; ++x) {
-            // Normalize pixel value to [0, 1]
-            input(y * 512 + x) = static_cast<float>(qGray(processedImage.pixel(x, y))) / 255.0f;
+        // Smooth scaling may hand back a different format
+        if (processedImage.format() != QImage::Format_Grayscale8) {
+            processedImage = processedImage.convertToFormat(QImage::Format_Grayscale8);
         }
     }
 
-    return input;
+    return processedImage;
+}
+
+float MLP::predict(const QImage& image) const
+{
+    InferenceContext context;
+    return predict(image, context);
 }
 
-float MLP::predict(const QImage& image)
+float MLP::predict(const QImage& image, InferenceContext& context) const
 {
     // Preprocess image
     Eigen::VectorXf input = preprocessImage(image);
 
-    // Forward pass
-    Eigen::VectorXf output = forward(input);
+    // Forward pass; return probability
+    return infer(input, context)(0);
+}
 
-    // Return probability
-    return output(0);
+Eigen::VectorXf MLP::predictBatch(const Eigen::Ref<const Eigen::MatrixXf>& inputs, InferenceContext& context) const
+{
+    if (layers.empty()) {
+        return inputs.row(0).transpose();
+    }
+
+    // Layer outputs alternate between the two buffers of the context
+    layers[0].inferBatch(inputs, context.batchOutputs[0]);
+    for (size_t i = 1; i < layers.size(); ++i) {
+        layers[i].inferBatch(context.batchOutputs[(i - 1) % 2], context.batchOutputs[i % 2]);
+    }
+
+    return context.batchOutputs[(layers.size() - 1) % 2].row(0).transpose();
 }
 
-QJsonObject MLP::saveToJson() const
+Eigen::VectorXf MLP::predictBatch(const QList<QImage>& images, InferenceContext& context) const
 {
-    QJsonObject json;
+    context.batchInputs.resize(512 * 512, images.size());
+    for (qsizetype i = 0; i < images.size(); ++i) {
+        preprocessImage(images.at(i), context.batchInputs.col(i));
+    }
 
-    // Save architecture
+    return predictBatch(context.batchInputs, context);
+}
+
+QJsonObject MLP::architectureToJson() const
+{
     QJsonObject architecture;
     architecture["input_neurons"] = inputSize;
     architecture["output_neurons"] = outputSize;
@@ -154,7 +527,75 @@ QJsonObject MLP::saveToJson() const
     architecture["hidden_layers"] = hiddenLayersArray;
     architecture["output_activation"] = QString::fromStdString(layers.back().getActivationFunction());
 
-    json["architecture"] = architecture;
+    return architecture;
+}
+
+bool MLP::createLayers(const QJsonObject& architecture)
+{
+    const int fileInputSize = architecture["input_neurons"].toInt();
+    const int fileOutputSize = architecture["output_neurons"].toInt();
+    if (fileInputSize <= 0 || fileOutputSize <= 0) {
+        return false;
+    }
+
+    // A network created by fromFile takes its sizes from the file; any
+    // other network only accepts files that match it
+    if (inputSize == 0 && outputSize == 0) {
+        inputSize = fileInputSize;
+        outputSize = fileOutputSize;
+    } else if (fileInputSize != inputSize || fileOutputSize != outputSize) {
+        return false;
+    }
+
+    // Get hidden layers configuration
+    QJsonArray hiddenLayersArray = architecture["hidden_layers"].toArray();
+
+    // Extract hidden layer sizes and activations
+    std::vector<int> newHiddenSizes;
+    std::vector<std::string> hiddenActivations;
+
+    for (int i = 0; i < hiddenLayersArray.size(); ++i) {
+        QJsonObject hiddenLayer = hiddenLayersArray[i].toObject();
+        if (hiddenLayer["neurons"].toInt() <= 0) {
+            return false;
+        }
+        newHiddenSizes.push_back(hiddenLayer["neurons"].toInt());
+        hiddenActivations.push_back(hiddenLayer["activation"].toString().toStdString());
+    }
+
+    QString outputActivation = architecture["output_activation"].toString();
+
+    // Recreate the network with the specified hidden layers. Every caller
+    // overwrites all weights and biases, so the layers are not initialized.
+    layers.clear();
+    hiddenSizes = newHiddenSizes;
+    seed = 0;
+
+    if (hiddenSizes.empty()) {
+        // If no hidden layers, create a direct input-to-output layer
+        layers.push_back(Layer(inputSize, outputSize, outputActivation.toStdString(), false));
+    } else {
+        // Create first hidden layer (input to first hidden)
+        layers.push_back(Layer(inputSize, hiddenSizes[0], hiddenActivations[0], false));
+
+        // Create additional hidden layers
+        for (size_t i = 1; i < hiddenSizes.size(); ++i) {
+            layers.push_back(Layer(hiddenSizes[i-1], hiddenSizes[i], hiddenActivations[i], false));
+        }
+
+        // Create output layer (last hidden to output)
+        layers.push_back(Layer(hiddenSizes.back(), outputSize, outputActivation.toStdString(), false));
+    }
+
+    return true;
+}
+
+QJsonObject MLP::saveToJson() const
+{
+    QJsonObject json;
+
+    // Save architecture
+    json["architecture"] = architectureToJson();
 
     // Save weights and biases
     QJsonObject weights;
@@ -164,20 +605,6 @@ QJsonObject MLP::saveToJson() const
     for (size_t i = 0; i < layers.size(); ++i) {
         const Layer& layer = layers[i];
 
-        // Create a name for this layer's weights and biases
-        QString layerName;
-        if (i == 0) {
-            layerName = "input_to_hidden1";
-        } else if (i == layers.size() - 1) {
-            if (numHiddenLayers == 0) {
-                layerName = "input_to_output";
-            } else {
-                layerName = QString("hidden%1_to_output").arg(numHiddenLayers);
-            }
-        } else {
-            layerName = QString("hidden%1_to_hidden%2").arg(i).arg(i + 1);
-        }
-
         // Save weights
         QJsonArray layerWeights;
         for (int row = 0; row < layer.getOutputSize(); ++row) {
@@ -187,23 +614,14 @@ QJsonObject MLP::saveToJson() const
             }
             layerWeights.append(rowArray);
         }
-        weights[layerName] = layerWeights;
+        weights[weightsName(i, layers.size())] = layerWeights;
 
         // Save biases
         QJsonArray layerBiases;
         for (int j = 0; j < layer.getOutputSize(); ++j) {
             layerBiases.append(layer.getBiases()(j));
         }
-
-        // Name for biases
-        QString biasName;
-        if (i == layers.size() - 1) {
-            biasName = "output";
-        } else {
-            biasName = QString("hidden%1").arg(i + 1);
-        }
-
-        biases[biasName] = layerBiases;
+        biases[biasesName(i, layers.size())] = layerBiases;
     }
 
     json["weights"] = weights;
@@ -213,54 +631,22 @@ QJsonObject MLP::saveToJson() const
 }
 
 bool MLP::loadFromJson(const QJsonObject& json)
+{
+    return loadReplacing([&json](MLP& model) { return model.readJson(json); });
+}
+
+bool MLP::readJson(const QJsonObject& json)
 {
     // Check if the JSON object has the required fields
     if (!json.contains("architecture") || !json.contains("weights") || !json.contains("biases")) {
         return false;
     }
 
-    // Load architecture
-    QJsonObject architecture = json["architecture"].toObject();
-    if (architecture["input_neurons"].toInt() != inputSize ||
-        architecture["output_neurons"].toInt() != outputSize) {
+    // Recreate the network with the stored architecture
+    if (!createLayers(json["architecture"].toObject())) {
         return false;
     }
 
-    // Get hidden layers configuration
-    QJsonArray hiddenLayersArray = architecture["hidden_layers"].toArray();
-
-    // Extract hidden layer sizes and activations
-    std::vector<int> newHiddenSizes;
-    std::vector<std::string> hiddenActivations;
-
-    for (int i = 0; i < hiddenLayersArray.size(); ++i) {
-        QJsonObject hiddenLayer = hiddenLayersArray[i].toObject();
-        newHiddenSizes.push_back(hiddenLayer["neurons"].toInt());
-        hiddenActivations.push_back(hiddenLayer["activation"].toString().toStdString());
-    }
-
-    QString outputActivation = architecture["output_activation"].toString();
-
-    // Recreate the network with the specified hidden layers
-    layers.clear();
-    hiddenSizes = newHiddenSizes;
-
-    if (hiddenSizes.empty()) {
-        // If no hidden layers, create a direct input-to-output layer
-        layers.push_back(Layer(inputSize, outputSize, outputActivation.toStdString()));
-    } else {
-        // Create first hidden layer (input to first hidden)
-        layers.push_back(Layer(inputSize, hiddenSizes[0], hiddenActivations[0]));
-
-        // Create additional hidden layers
-        for (size_t i = 1; i < hiddenSizes.size(); ++i) {
-            layers.push_back(Layer(hiddenSizes[i-1], hiddenSizes[i], hiddenActivations[i]));
-        }
-
-        // Create output layer (last hidden to output)
-        layers.push_back(Layer(hiddenSizes.back(), outputSize, outputActivation.toStdString()));
-    }
-
     // Load weights and biases
     QJsonObject weights = json["weights"].toObject();
     QJsonObject biases = json["biases"].toObject();
@@ -269,27 +655,14 @@ bool MLP::loadFromJson(const QJsonObject& json)
     for (size_t i = 0; i < layers.size(); ++i) {
         Layer& layer = layers[i];
 
-        // Create a name for this layer's weights and biases
-        QString layerName;
-        if (i == 0) {
-            layerName = "input_to_hidden1";
-        } else if (i == layers.size() - 1) {
-            if (hiddenSizes.empty()) {
-                layerName = "input_to_output";
-            } else {
-                layerName = QString("hidden%1_to_output").arg(hiddenSizes.size());
-            }
-        } else {
-            layerName = QString("hidden%1_to_hidden%2").arg(i).arg(i + 1);
-        }
-
         // Load weights
+        const QString layerName = weightsName(i, layers.size());
         if (!weights.contains(layerName)) {
             return false;
         }
 
         QJsonArray layerWeights = weights[layerName].toArray();
-        Eigen::MatrixXf weightMatrix(layer.getOutputSize(), layer.getInputSize());
+        WeightMatrix weightMatrix(layer.getOutputSize(), layer.getInputSize());
 
         for (int row = 0; row < layer.getOutputSize(); ++row) {
             QJsonArray rowArray = layerWeights[row].toArray();
@@ -299,15 +672,8 @@ bool MLP::loadFromJson(const QJsonObject& json)
         }
         layer.setWeights(weightMatrix);
 
-        // Name for biases
-        QString biasName;
-        if (i == layers.size() - 1) {
-            biasName = "output";
-        } else {
-            biasName = QString("hidden%1").arg(i + 1);
-        }
-
         // Load biases
+        const QString biasName = biasesName(i, layers.size());
         if (!biases.contains(biasName)) {
             return false;
         }
@@ -324,46 +690,236 @@ bool MLP::loadFromJson(const QJsonObject& json)
     return true;
 }
 
-bool MLP::saveToBinary(const QString& filePath) const
+bool MLP::saveToJsonFile(const QString& filePath) const
 {
-    QFile file(filePath);
+    QSaveFile file(filePath);
     if (!file.open(QIODevice::WriteOnly)) {
         return false;
     }
 
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    // Same document as saveToJson, with the keys in the order QJsonDocument
+    // writes them, but written a row at a time
+    JsonStreamWriter writer(&file);
+    writer.write("{\n    \"architecture\": ");
+    writer.write(QJsonDocument(architectureToJson()).toJson(QJsonDocument::Compact));
 
-    // Write magic number and version (using little-endian format for new models)
-    stream << MAGIC_NUMBER << FORMAT_VERSION;
+    writer.write(",\n    \"biases\": {");
+    for (size_t i = 0; i < layers.size(); ++i) {
+        BiasMap biases = layers[i].getBiases();
+        writer.write(i == 0 ? "\n        " : ",\n        ");
+        writer.writeString(biasesName(i, layers.size()));
+        writer.write(": [");
+        for (Eigen::Index j = 0; j < biases.size(); ++j) {
+            if (j > 0) {
+                writer.write(",");
+            }
+            writer.writeFloat(biases(j));
+        }
+        writer.write("]");
+    }
 
-    // Create JSON metadata
-    QJsonObject metadata;
+    writer.write("\n    },\n    \"weights\": {");
+    for (size_t i = 0; i < layers.size(); ++i) {
+        WeightMap weights = layers[i].getWeights();
+        writer.write(i == 0 ? "\n        " : ",\n        ");
+        writer.writeString(weightsName(i, layers.size()));
+        writer.write(": [");
+        for (Eigen::Index row = 0; row < weights.rows(); ++row) {
+            writer.write(row == 0 ? "\n            [" : ",\n            [");
+            for (Eigen::Index col = 0; col < weights.cols(); ++col) {
+                if (col > 0) {
+                    writer.write(",");
+                }
+                writer.writeFloat(weights(row, col));
+            }
+            writer.write("]");
+        }
+        writer.write("\n        ]");
+    }
+    writer.write("\n    }\n}\n");
 
-    // Save architecture
-    QJsonObject architecture;
-    architecture["input_neurons"] = inputSize;
-    architecture["output_neurons"] = outputSize;
+    if (!writer.flush()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
 
-    // Save hidden layers configuration
-    QJsonArray hiddenLayersArray;
-    int numHiddenLayers = getNumHiddenLayers();
+bool MLP::loadFromJsonFile(const QString& filePath)
+{
+    return loadReplacing([&filePath](MLP& model) { return model.readJsonFile(filePath); });
+}
 
-    for (int i = 0; i < numHiddenLayers; ++i) {
-        QJsonObject hiddenLayer;
-        hiddenLayer["neurons"] = layers[i].getOutputSize();
-        hiddenLayer["activation"] = QString::fromStdString(layers[i].getActivationFunction());
-        hiddenLayersArray.append(hiddenLayer);
+bool MLP::readJsonFile(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
     }
 
-    architecture["hidden_layers"] = hiddenLayersArray;
+    JsonStreamReader reader(&file);
+    QString key;
+    if (!reader.beginObject() || !reader.nextKey(key)) {
+        return false;
+    }
 
-    // Save output layer activation
-    architecture["output_activation"] = QString::fromStdString(layers.back().getActivationFunction());
+    // The layers have to exist before their weights can be streamed into
+    // them. Files written by this class and by saveToJson list the
+    // architecture first; anything else is parsed in one piece.
+    if (key != "architecture") {
+        if (!file.seek(0)) {
+            return false;
+        }
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+        return doc.isObject() && readJson(doc.object());
+    }
+
+    QByteArray architectureText;
+    if (!reader.readRaw(architectureText) ||
+        !createLayers(QJsonDocument::fromJson(architectureText).object())) {
+        return false;
+    }
+
+    // Numbers are parsed straight into the layers, a row at a time
+    std::vector<char> weightsRead(layers.size(), 0);
+    std::vector<char> biasesRead(layers.size(), 0);
+    while (reader.nextKey(key)) {
+        const bool isWeights = key == "weights";
+        if (!isWeights && key != "biases") {
+            if (!reader.skipValue()) {
+                return false;
+            }
+            continue;
+        }
+
+        QString name;
+        if (!reader.beginObject()) {
+            return false;
+        }
+        while (reader.nextKey(name)) {
+            size_t i = 0;
+            while (i < layers.size() &&
+                   name != (isWeights ? weightsName(i, layers.size()) : biasesName(i, layers.size()))) {
+                ++i;
+            }
+            if (i == layers.size()) {
+                if (!reader.skipValue()) {
+                    return false;
+                }
+                continue;
+            }
 
-    metadata["architecture"] = architecture;
+            Layer& layer = layers[i];
+            bool ok;
+            if (isWeights) {
+                float* data = layer.weightData();
+                ok = reader.beginArray();
+                for (int row = 0; ok && row < layer.getOutputSize(); ++row) {
+                    ok = reader.nextElement() &&
+                         readFloatArray(reader, data + static_cast<qint64>(row) * layer.getInputSize(),
+                                        layer.getInputSize());
+                }
+                ok = ok && !reader.nextElement() && !reader.hasError();
+                weightsRead[i] = 1;
+            } else {
+                ok = readFloatArray(reader, layer.biasData(), layer.getOutputSize());
+                biasesRead[i] = 1;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+
+    if (reader.hasError()) {
+        return false;
+    }
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (!weightsRead[i] || !biasesRead[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MLP::saveToBinary(const QString& filePath, const BinaryOptions& options) const
+{
+    if (options.formatVersion != FORMAT_VERSION && options.formatVersion != FORMAT_VERSION_ALIGNED) {
+        return false;
+    }
+    const bool aligned = options.formatVersion == FORMAT_VERSION_ALIGNED;
+    const bool compressed = aligned && options.compressionLevel != 0;
+
+    // Written to a temporary file that replaces the target only once complete
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    // Write magic number and version (using little-endian format for new models)
+    stream << MAGIC_NUMBER << options.formatVersion;
+
+    // Create JSON metadata
+    QJsonObject metadata;
+
+    // Save architecture
+    metadata["architecture"] = architectureToJson();
     metadata["data_precision"] = "float";
+    if (!options.trainingState.isEmpty()) {
+        metadata["training_state"] = options.trainingState;
+    }
+
+    // The weights are still in memory, so their checksums can go in the
+    // metadata ahead of them
+    const qint64 chunkFloats = std::min(COMPRESSION_CHUNK_FLOATS, parameterCount());
+    const std::vector<std::pair<const float*, qint64>> chunks = parameterChunks(chunkFloats);
+    if (options.checksums) {
+        QJsonArray checksums;
+        for (quint32 checksum : chunkChecksums(chunks)) {
+            checksums.append(static_cast<qint64>(checksum));
+        }
+        metadata["checksum"] = "crc32c";
+        metadata["chunk_floats"] = chunkFloats;
+        metadata["checksums"] = checksums;
+    }
+
+    // Compressed version 3 files store a chunk index instead of block offsets,
+    // since the compressed sizes are not known until the chunks are written
+    if (compressed) {
+        metadata["alignment"] = BLOCK_ALIGNMENT;
+        metadata["storage_order"] = "row_major";
+        metadata["byte_order"] = "little_endian";
+        metadata["compression"] = "zlib";
+        metadata["byte_shuffle"] = true;
+        metadata["chunk_floats"] = chunkFloats;
+        metadata["chunk_count"] = static_cast<qint64>(chunks.size());
+    }
+
+    // Version 3 lists where each block starts, relative to the first aligned
+    // offset after the metadata so the offsets do not depend on its length
+    else if (aligned) {
+        QJsonArray blocks;
+        qint64 offset = 0;
+        for (const Layer& layer : layers) {
+            QJsonObject block;
+            block["weights_offset"] = offset;
+            offset = alignedOffset(offset + static_cast<qint64>(layer.getOutputSize()) * layer.getInputSize() *
+                                                static_cast<qint64>(sizeof(float)));
+            block["biases_offset"] = offset;
+            offset = alignedOffset(offset + layer.getOutputSize() * static_cast<qint64>(sizeof(float)));
+            blocks.append(block);
+        }
+
+        metadata["layers"] = blocks;
+        metadata["alignment"] = BLOCK_ALIGNMENT;
+        metadata["storage_order"] = "row_major";
+        metadata["byte_order"] = "little_endian";
+    }
 
     // Convert metadata to JSON string
     QJsonDocument doc(metadata);
@@ -373,82 +929,201 @@ bool MLP::saveToBinary(const QString& filePath) const
     stream << static_cast<quint32>(jsonData.size());
     stream.writeRawData(jsonData.constData(), jsonData.size());
 
-    // Write weights and biases as binary data for all layers
+    // Zero padding up to the next block boundary (version 3 only)
+    qint64 position = BINARY_HEADER_SIZE + jsonData.size();
+    auto pad = [&]() {
+        const qint64 padding = aligned ? alignedOffset(position) - position : 0;
+        position += padding;
+        return padding == 0 ||
+               stream.writeRawData(QByteArray(static_cast<qsizetype>(padding), '\0').constData(),
+                                   static_cast<int>(padding)) == padding;
+    };
+
+    if (compressed) {
+        bool ok = pad() && writeCompressedLayers(file, position, chunkFloats, options.compressionLevel);
+        return ok && stream.status() == QDataStream::Ok && file.commit();
+    }
+
+    // Write weights and biases as binary data for all layers; row-major
+    // weights are already in file order, so each is a single block
     for (size_t i = 0; i < layers.size(); ++i) {
         const Layer& layer = layers[i];
-        const Eigen::MatrixXf& weights = layer.getWeights();
-        const Eigen::VectorXf& biases = layer.getBiases();
+        const WeightMap weights = layer.getWeights();
+        const BiasMap biases = layer.getBiases();
 
-        // Write weights
-        for (int row = 0; row < weights.rows(); ++row) {
-            for (int col = 0; col < weights.cols(); ++col) {
-                stream << static_cast<float>(weights(row, col));
-            }
+        if (!pad() || !writeFloats(stream, weights.data(), weights.size())) {
+            return false;
         }
+        position += weights.size() * static_cast<qint64>(sizeof(float));
 
-        // Write biases
-        for (int j = 0; j < biases.size(); ++j) {
-            stream << static_cast<float>(biases(j));
+        if (!pad() || !writeFloats(stream, biases.data(), biases.size())) {
+            return false;
         }
+        position += biases.size() * static_cast<qint64>(sizeof(float));
     }
 
-    file.close();
-    return true;
+    return stream.status() == QDataStream::Ok && file.commit();
 }
 
-bool MLP::loadFromBinary(const QString& filePath)
+bool MLP::readBinaryHeader(QFile& file, quint8& formatVersion, QJsonObject& metadata)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return false;
-    }
-
     QDataStream stream(&file);
     stream.setByteOrder(QDataStream::LittleEndian);
-    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
 
     // Read and verify magic number and version
     quint32 magicNumber;
-    quint8 formatVersion;
     stream >> magicNumber >> formatVersion;
 
     // Accept both magic number formats for compatibility
-    if (magicNumber != MAGIC_NUMBER && magicNumber != MAGIC_NUMBER_REVERSED) {
-        file.close();
+    if (stream.status() != QDataStream::Ok ||
+        (magicNumber != MAGIC_NUMBER && magicNumber != MAGIC_NUMBER_REVERSED)) {
         return false;
     }
 
     // Read metadata length and metadata
     quint32 jsonLength;
     stream >> jsonLength;
+    if (stream.status() != QDataStream::Ok || jsonLength > file.size() - BINARY_HEADER_SIZE) {
+        return false;
+    }
 
     QByteArray jsonData = file.read(jsonLength);
-    if (jsonData.size() != static_cast<int>(jsonLength)) {
-        file.close();
+    if (jsonData.size() != static_cast<qsizetype>(jsonLength)) {
         return false;
     }
 
     // Parse metadata
     QJsonDocument doc = QJsonDocument::fromJson(jsonData);
     if (doc.isNull() || !doc.isObject()) {
-        file.close();
         return false;
     }
 
-    QJsonObject metadata = doc.object();
+    metadata = doc.object();
+    return true;
+}
 
-    // Verify architecture
-    QJsonObject architecture = metadata["architecture"].toObject();
-    if (architecture["input_neurons"].toInt() != inputSize ||
-        architecture["output_neurons"].toInt() != outputSize) {
-        file.close();
+bool MLP::inspectFile(const QString& filePath, ModelInfo& info)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    info = ModelInfo();
+    info.fileSize = file.size();
+
+    // Only the header and metadata are read, or for JSON files the
+    // architecture, which comes first
+    QJsonObject architecture;
+    uchar header[sizeof(quint32)];
+    const bool binary = file.peek(reinterpret_cast<char*>(header), sizeof(header)) == sizeof(header) &&
+                        (qFromLittleEndian<quint32>(header) == MAGIC_NUMBER ||
+                         qFromLittleEndian<quint32>(header) == MAGIC_NUMBER_REVERSED);
+    if (binary) {
+        QJsonObject metadata;
+        if (!readBinaryHeader(file, info.formatVersion, metadata)) {
+            return false;
+        }
+        architecture = metadata["architecture"].toObject();
+        info.dataPrecision = metadata["data_precision"].toString();
+        info.compression = metadata["compression"].toString();
+        info.checksum = metadata["checksum"].toString();
+        info.trainingState = metadata["training_state"].toObject();
+    } else {
+        JsonStreamReader reader(&file);
+        QString key;
+        QByteArray architectureText;
+        if (!reader.beginObject() || !reader.nextKey(key) || key != "architecture" ||
+            !reader.readRaw(architectureText)) {
+            return false;
+        }
+        architecture = QJsonDocument::fromJson(architectureText).object();
+        info.formatVersion = 0;
+        info.dataPrecision = "json";
+    }
+
+    info.inputSize = architecture["input_neurons"].toInt();
+    info.outputSize = architecture["output_neurons"].toInt();
+    info.outputActivation = architecture["output_activation"].toString();
+    if (info.inputSize <= 0 || info.outputSize <= 0) {
+        return false;
+    }
+
+    QJsonArray hiddenLayersArray = architecture["hidden_layers"].toArray();
+    for (int i = 0; i < hiddenLayersArray.size(); ++i) {
+        QJsonObject hiddenLayer = hiddenLayersArray[i].toObject();
+        if (hiddenLayer["neurons"].toInt() <= 0) {
+            return false;
+        }
+        info.hiddenSizes.push_back(hiddenLayer["neurons"].toInt());
+        info.hiddenActivations.append(hiddenLayer["activation"].toString());
+    }
+
+    // Weights and biases of every layer
+    qint64 previous = info.inputSize;
+    for (int size : info.hiddenSizes) {
+        info.parameterCount += previous * size + size;
+        previous = size;
+    }
+    info.parameterCount += previous * info.outputSize + info.outputSize;
+
+    return true;
+}
+
+bool MLP::loadFromBinary(const QString& filePath)
+{
+    return loadReplacing([&filePath](MLP& model) { return model.loadBinary(filePath, false); });
+}
+
+bool MLP::mapFromBinary(const QString& filePath)
+{
+    return loadReplacing([&filePath](MLP& model) { return model.loadBinary(filePath, true); });
+}
+
+bool MLP::loadReplacing(const std::function<bool(MLP&)>& load)
+{
+    // The new network only accepts files that fit this one, as createLayers
+    // checks against its sizes
+    MLP loaded;
+    loaded.inputSize = inputSize;
+    loaded.outputSize = outputSize;
+    loaded.seed = seed;
+    if (!load(loaded)) {
+        return false;
+    }
+
+    *this = std::move(loaded);
+    return true;
+}
+
+bool MLP::loadBinary(const QString& filePath, bool map)
+{
+    // Shared so that mapped layers can keep the file open
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
         return false;
     }
 
+    // Read and verify the header and metadata
+    quint8 formatVersion;
+    QJsonObject metadata;
+    if (!readBinaryHeader(*file, formatVersion, metadata)) {
+        file->close();
+        return false;
+    }
+    const qint64 metadataEnd = file->pos();
+
+    QDataStream stream(file.get());
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    // The architecture is checked when the layers are created
+    QJsonObject architecture = metadata["architecture"].toObject();
+
     // Verify data precision
     QString dataPrecision = metadata["data_precision"].toString();
     if (dataPrecision != "float") {
-        file.close();
+        file->close();
         return false;
     }
 
@@ -459,130 +1134,339 @@ bool MLP::loadFromBinary(const QString& filePath)
     if (formatVersion == 0x01) {
         // Old format with single hidden layer
         if (hiddenLayersArray.size() != 1) {
-            file.close();
+            file->close();
             return false;
         }
 
-        int hiddenSize = hiddenLayersArray[0].toObject()["neurons"].toInt();
-        QString hiddenActivation = hiddenLayersArray[0].toObject()["activation"].toString();
-        QString outputActivation = architecture["output_activation"].toString();
-
         // Recreate the network with a single hidden layer
-        layers.clear();
-        hiddenSizes = {hiddenSize};
-        layers.push_back(Layer(inputSize, hiddenSize, hiddenActivation.toStdString()));
-        layers.push_back(Layer(hiddenSize, outputSize, outputActivation.toStdString()));
+        if (!createLayers(architecture)) {
+            file->close();
+            return false;
+        }
 
         // Read weights and biases
-
-        // Layer 0 weights (input to hidden)
-        Eigen::MatrixXf inputToHiddenWeights(hiddenSize, inputSize);
-        for (int i = 0; i < hiddenSize; ++i) {
-            for (int j = 0; j < inputSize; ++j) {
-                float value;
-                stream >> value;
-                inputToHiddenWeights(i, j) = value;
-            }
+        if (!readLayers(stream)) {
+            file->close();
+            return false;
         }
-        layers[0].setWeights(inputToHiddenWeights);
+    }
+    else if (formatVersion == 0x02 || formatVersion == FORMAT_VERSION_ALIGNED) {
+        // New format with multiple hidden layers
 
-        // Layer 0 biases (hidden)
-        Eigen::VectorXf hiddenBiases(hiddenSize);
-        for (int i = 0; i < hiddenSize; ++i) {
-            float value;
-            stream >> value;
-            hiddenBiases(i) = value;
+        // Recreate the network with the specified hidden layers
+        if (!createLayers(architecture)) {
+            file->close();
+            return false;
         }
-        layers[0].setBiases(hiddenBiases);
 
-        // Layer 1 weights (hidden to output)
-        Eigen::MatrixXf hiddenToOutputWeights(outputSize, hiddenSize);
-        for (int i = 0; i < outputSize; ++i) {
-            for (int j = 0; j < hiddenSize; ++j) {
-                float value;
-                stream >> value;
-                hiddenToOutputWeights(i, j) = value;
-            }
+        // Read weights and biases for all layers; version 3 blocks may be
+        // used in place
+        bool ok = formatVersion == FORMAT_VERSION_ALIGNED
+                      ? readAlignedLayers(file, metadata, metadataEnd, map)
+                      : readLayers(stream);
+        if (!ok) {
+            file->close();
+            return false;
         }
-        layers[1].setWeights(hiddenToOutputWeights);
+    }
+    else {
+        // Unsupported format version
+        file->close();
+        return false;
+    }
 
-        // Layer 1 biases (output)
-        Eigen::VectorXf outputBiases(outputSize);
-        for (int i = 0; i < outputSize; ++i) {
-            float value;
-            stream >> value;
-            outputBiases(i) = value;
+    // Every chunk has to match before the weights are trusted
+    if (!verifyChecksums(metadata)) {
+        qWarning() << "Checksum mismatch, the model file is corrupted:" << filePath;
+        return false;
+    }
+
+    // Mapped layers hold their own reference to the file, which stays open
+    // until the last of them lets go of it
+    return true;
+}
+
+bool MLP::readLayers(QDataStream& stream)
+{
+    // Each layer's weights and biases are contiguous in the file and in
+    // memory, so they are read straight into the layer's storage
+    for (Layer& layer : layers) {
+        const qint64 weightCount = static_cast<qint64>(layer.getOutputSize()) * layer.getInputSize();
+        if (!readFloats(stream, layer.weightData(), weightCount) ||
+            !readFloats(stream, layer.biasData(), layer.getOutputSize())) {
+            return false;
         }
-        layers[1].setBiases(outputBiases);
     }
-    else if (formatVersion == 0x02) {
-        // New format with multiple hidden layers
 
-        // Extract hidden layer sizes and activations
-        std::vector<int> newHiddenSizes;
-        std::vector<std::string> hiddenActivations;
+    return true;
+}
+
+bool MLP::readAlignedLayers(const std::shared_ptr<QFile>& file, const QJsonObject& metadata,
+                            qint64 metadataEnd, bool map)
+{
+    const QString storageOrder = metadata["storage_order"].toString();
+    const bool rowMajor = storageOrder == "row_major";
+    const qint64 alignment = metadata["alignment"].toInteger(BLOCK_ALIGNMENT);
 
-        for (int i = 0; i < hiddenLayersArray.size(); ++i) {
-            QJsonObject hiddenLayer = hiddenLayersArray[i].toObject();
-            newHiddenSizes.push_back(hiddenLayer["neurons"].toInt());
-            hiddenActivations.push_back(hiddenLayer["activation"].toString().toStdString());
+    // Compressed files cannot be used in place
+    if (metadata.contains("compression")) {
+        if (!rowMajor || alignment <= 0 || metadata["byte_order"].toString() != "little_endian") {
+            return false;
         }
+        return readCompressedLayers(file, metadata, (metadataEnd + alignment - 1) / alignment * alignment);
+    }
 
-        QString outputActivation = architecture["output_activation"].toString();
+    QJsonArray blocks = metadata["layers"].toArray();
 
-        // Recreate the network with the specified hidden layers
-        layers.clear();
-        hiddenSizes = newHiddenSizes;
+    if (blocks.size() != static_cast<qsizetype>(layers.size()) ||
+        metadata["byte_order"].toString() != "little_endian" ||
+        (!rowMajor && storageOrder != "column_major") ||
+        alignment <= 0 || alignment % static_cast<qint64>(sizeof(float)) != 0) {
+        return false;
+    }
 
-        if (hiddenSizes.empty()) {
-            // If no hidden layers, create a direct input-to-output layer
-            layers.push_back(Layer(inputSize, outputSize, outputActivation.toStdString()));
-        } else {
-            // Create first hidden layer (input to first hidden)
-            layers.push_back(Layer(inputSize, hiddenSizes[0], hiddenActivations[0]));
+    // Resolve and check the absolute offset of every block
+    const qint64 payloadStart = (metadataEnd + alignment - 1) / alignment * alignment;
+    const qint64 fileSize = file->size();
+    std::vector<qint64> weightOffsets(layers.size());
+    std::vector<qint64> biasOffsets(layers.size());
 
-            // Create additional hidden layers
-            for (size_t i = 1; i < hiddenSizes.size(); ++i) {
-                layers.push_back(Layer(hiddenSizes[i-1], hiddenSizes[i], hiddenActivations[i]));
-            }
+    for (size_t i = 0; i < layers.size(); ++i) {
+        QJsonObject block = blocks[static_cast<qsizetype>(i)].toObject();
+        const qint64 weightOffset = block["weights_offset"].toInteger(-1);
+        const qint64 biasOffset = block["biases_offset"].toInteger(-1);
+        const qint64 weightBytes = static_cast<qint64>(layers[i].getOutputSize()) * layers[i].getInputSize() *
+                                   static_cast<qint64>(sizeof(float));
+        const qint64 biasBytes = layers[i].getOutputSize() * static_cast<qint64>(sizeof(float));
+
+        if (weightOffset < 0 || biasOffset < 0 || weightOffset % alignment != 0 || biasOffset % alignment != 0 ||
+            payloadStart + weightOffset + weightBytes > fileSize ||
+            payloadStart + biasOffset + biasBytes > fileSize) {
+            return false;
+        }
+
+        weightOffsets[i] = payloadStart + weightOffset;
+        biasOffsets[i] = payloadStart + biasOffset;
+    }
 
-            // Create output layer (last hidden to output)
-            layers.push_back(Layer(hiddenSizes.back(), outputSize, outputActivation.toStdString()));
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // Row-major little-endian blocks are exactly the layers' in-memory
+    // layout, so the layers can use the mapped file directly
+    if (map && rowMajor) {
+        const uchar* base = file->map(0, fileSize);
+        if (base) {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                layers[i].mapParameters(reinterpret_cast<const float*>(base + weightOffsets[i]),
+                                        reinterpret_cast<const float*>(base + biasOffsets[i]), file);
+            }
+            return true;
         }
+    }
+#else
+    Q_UNUSED(map);
+#endif
 
-        // Read weights and biases for all layers
-        for (size_t i = 0; i < layers.size(); ++i) {
-            Layer& layer = layers[i];
-            int outputSize = layer.getOutputSize();
-            int inputSize = layer.getInputSize();
-
-            // Read weights
-            Eigen::MatrixXf weights(outputSize, inputSize);
-            for (int row = 0; row < outputSize; ++row) {
-                for (int col = 0; col < inputSize; ++col) {
-                    float value;
-                    stream >> value;
-                    weights(row, col) = value;
-                }
+    // Otherwise read each block into the layers
+    QDataStream stream(file.get());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        Layer& layer = layers[i];
+        const qint64 weightCount = static_cast<qint64>(layer.getOutputSize()) * layer.getInputSize();
+
+        if (!file->seek(weightOffsets[i])) {
+            return false;
+        }
+        if (rowMajor) {
+            if (!readFloats(stream, layer.weightData(), weightCount)) {
+                return false;
+            }
+        } else {
+            Eigen::MatrixXf weights(layer.getOutputSize(), layer.getInputSize());
+            if (!readFloats(stream, weights.data(), weightCount)) {
+                return false;
             }
             layer.setWeights(weights);
+        }
+
+        if (!file->seek(biasOffsets[i]) || !readFloats(stream, layer.biasData(), layer.getOutputSize())) {
+            return false;
+        }
+    }
 
-            // Read biases
-            Eigen::VectorXf biases(outputSize);
-            for (int j = 0; j < outputSize; ++j) {
-                float value;
-                stream >> value;
-                biases(j) = value;
+    return true;
+}
+
+bool MLP::writeCompressedLayers(QFileDevice& file, qint64 indexOffset, qint64 chunkFloats, int level) const
+{
+    const std::vector<std::pair<const float*, qint64>> chunks = parameterChunks(chunkFloats);
+
+    // Leave room for the index of compressed chunk sizes
+    const qint64 indexSize = static_cast<qint64>(chunks.size() * sizeof(quint64));
+    if (file.write(QByteArray(static_cast<qsizetype>(indexSize), '\0')) != indexSize) {
+        return false;
+    }
+
+    // Compress a batch of chunks at a time in parallel and write them in
+    // order, so only one batch of compressed data is held in memory
+    std::vector<quint64> sizes(chunks.size(), 0);
+    QThreadPool pool;
+    const size_t batchSize = static_cast<size_t>(qMax(1, pool.maxThreadCount()) * 2);
+
+    for (size_t start = 0; start < chunks.size(); start += batchSize) {
+        const size_t end = std::min(chunks.size(), start + batchSize);
+        std::vector<QByteArray> compressed(end - start);
+        for (size_t i = start; i < end; ++i) {
+            pool.start([&chunks, &compressed, i, start, level]() {
+                compressed[i - start] = compressChunk(chunks[i].first, chunks[i].second, level);
+            });
+        }
+        pool.waitForDone();
+
+        for (size_t i = start; i < end; ++i) {
+            const QByteArray& data = compressed[i - start];
+            if (data.isEmpty() || file.write(data) != data.size()) {
+                return false;
             }
-            layer.setBiases(biases);
+            sizes[i] = static_cast<quint64>(data.size());
         }
     }
-    else {
-        // Unsupported format version
-        file.close();
+
+    // Go back and fill in the index
+    if (!file.seek(indexOffset)) {
         return false;
     }
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    for (quint64 size : sizes) {
+        stream << size;
+    }
 
-    file.close();
-    return true;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool MLP::readCompressedLayers(const std::shared_ptr<QFile>& file, const QJsonObject& metadata, qint64 payloadStart)
+{
+    const qint64 chunkFloats = metadata["chunk_floats"].toInteger();
+    if (metadata["compression"].toString() != "zlib" || !metadata["byte_shuffle"].toBool() ||
+        !isValidChunkSize(chunkFloats)) {
+        return false;
+    }
+
+    std::vector<std::pair<float*, qint64>> chunks;
+    for (Layer& layer : layers) {
+        appendChunks(chunks, layer.weightData(), static_cast<qint64>(layer.getOutputSize()) * layer.getInputSize(), chunkFloats);
+        appendChunks(chunks, layer.biasData(), static_cast<qint64>(layer.getOutputSize()), chunkFloats);
+    }
+    if (metadata["chunk_count"].toInteger() != static_cast<qint64>(chunks.size())) {
+        return false;
+    }
+
+    // Read the index and work out where each chunk starts
+    if (!file->seek(payloadStart)) {
+        return false;
+    }
+    QDataStream stream(file.get());
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    const qint64 dataStart = payloadStart + static_cast<qint64>(chunks.size() * sizeof(quint64));
+    std::vector<qint64> offsets(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        quint64 size;
+        stream >> size;
+        if (stream.status() != QDataStream::Ok || size == 0 || size > static_cast<quint64>(file->size())) {
+            return false;
+        }
+        offsets[i + 1] = offsets[i] + static_cast<qint64>(size);
+    }
+    const qint64 dataSize = offsets.back();
+    if (dataStart + dataSize > file->size()) {
+        return false;
+    }
+
+    // Map the compressed data, or read it in one go if that is not possible
+    QByteArray buffer;
+    const uchar* data = file->map(dataStart, dataSize);
+    const bool mapped = data != nullptr;
+    if (!mapped) {
+        buffer = file->read(dataSize);
+        if (buffer.size() != dataSize) {
+            return false;
+        }
+        data = reinterpret_cast<const uchar*>(buffer.constData());
+    }
+
+    // Chunks decompress into disjoint parts of the layers, so they can all
+    // run at once
+    QAtomicInt failed(0);
+    QThreadPool pool;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        pool.start([&chunks, &offsets, &failed, data, i]() {
+            if (!decompressChunk(data + offsets[i], offsets[i + 1] - offsets[i], chunks[i].first, chunks[i].second)) {
+                failed.storeRelaxed(1);
+            }
+        });
+    }
+    pool.waitForDone();
+
+    if (mapped) {
+        file->unmap(const_cast<uchar*>(data));
+    }
+
+    return failed.loadRelaxed() == 0;
+}
+
+qint64 MLP::parameterCount() const
+{
+    qint64 count = 0;
+    for (const Layer& layer : layers) {
+        count += static_cast<qint64>(layer.getOutputSize()) * layer.getInputSize() + layer.getOutputSize();
+    }
+    return count;
+}
+
+bool MLP::isValidChunkSize(qint64 chunkFloats) const
+{
+    return chunkFloats > 0 && chunkFloats <= parameterCount();
+}
+
+std::vector<std::pair<const float*, qint64>> MLP::parameterChunks(qint64 chunkFloats) const
+{
+    std::vector<std::pair<const float*, qint64>> chunks;
+    for (const Layer& layer : layers) {
+        appendChunks(chunks, layer.getWeights().data(), static_cast<qint64>(layer.getWeights().size()), chunkFloats);
+        appendChunks(chunks, layer.getBiases().data(), static_cast<qint64>(layer.getBiases().size()), chunkFloats);
+    }
+    return chunks;
+}
+
+bool MLP::verifyChecksums(const QJsonObject& metadata) const
+{
+    if (!metadata.contains("checksum")) {
+        return true;
+    }
+
+    const qint64 chunkFloats = metadata["chunk_floats"].toInteger();
+    if (metadata["checksum"].toString() != "crc32c" || !isValidChunkSize(chunkFloats)) {
+        return false;
+    }
+
+    const std::vector<std::pair<const float*, qint64>> chunks = parameterChunks(chunkFloats);
+    const QJsonArray expected = metadata["checksums"].toArray();
+    if (expected.size() != static_cast<qsizetype>(chunks.size())) {
+        return false;
+    }
+
+    // Chunks are independent, so they are all checked at once
+    QAtomicInt failed(0);
+    QThreadPool pool;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const qint64 checksum = expected[static_cast<qsizetype>(i)].toInteger(-1);
+        pool.start([&chunks, &failed, checksum, i]() {
+            if (checksum != chunkChecksum(chunks[i].first, chunks[i].second)) {
+                failed.storeRelaxed(1);
+            }
+        });
+    }
+    pool.waitForDone();
+
+    return failed.loadRelaxed() == 0;
 }
@@ -4,12 +4,16 @@
 #include "layer.h"
 #include <vector>
 #include <string>
+#include <memory>
+#include <utility>
+#include <functional>
 #include </usr/local/include/Eigen/Dense>
 #include <QImage>
 #include <QJsonObject>
 #include <QFile>
 #include <QDataStream>
 #include <QByteArray>
+#include <QStringList>
 #include <QJsonDocument>
 
 /**
@@ -18,6 +22,85 @@
 class MLP
 {
 public:
+    /**
+     * @brief Options for writing binary model files
+     */
+    struct BinaryOptions
+    {
+        BinaryOptions() : formatVersion(0x02), compressionLevel(0), checksums(true) {}
+
+        /**
+         * Format version to write. Version 2 is read by every consumer of
+         * .senm files, including libnoodlenet. Version 3 stores every weight
+         * and bias block at a 64-byte aligned offset listed in the metadata,
+         * so it can be used in place by mapFromBinary.
+         */
+        quint8 formatVersion;
+
+        /**
+         * zlib level (1-9, or -1 for zlib's default) used to compress version 3
+         * files, or 0 to store the weights uncompressed. The weights are split
+         * into chunks of 1M floats that are byte-shuffled and compressed
+         * independently, so they can be decompressed in parallel on load.
+         * Compressed files cannot be memory-mapped.
+         */
+        int compressionLevel;
+
+        /**
+         * Whether to store a CRC-32C of every chunk of 1M weights in the
+         * metadata. Files with checksums only load if every chunk matches,
+         * so a corrupted file is rejected instead of giving wrong
+         * predictions. The chunks are checked in parallel, at several GB/s
+         * per core on processors with CRC32 instructions.
+         */
+        bool checksums;
+
+        /**
+         * Progress of the training run that produced the weights, stored in
+         * the metadata under "training_state" so that a checkpoint and the
+         * state needed to resume from it are replaced together. Left out
+         * when empty.
+         */
+        QJsonObject trainingState;
+    };
+
+    /**
+     * @brief Scratch space for infer and the const predict
+     *
+     * Holds the activations of one inference, so the network itself is not
+     * modified and may be shared by any number of threads, each with its own
+     * context. A context can be reused for any number of calls, which then
+     * allocate nothing.
+     */
+    struct InferenceContext
+    {
+        std::vector<Eigen::VectorXf> preActivations;  ///< Weighted input z of each layer
+        std::vector<Eigen::VectorXf> outputs;         ///< Output of each layer, the network's last
+        Eigen::MatrixXf batchInputs;                  ///< Preprocessed images of predictBatch, one per column
+        Eigen::MatrixXf batchOutputs[2];              ///< Layer outputs of predictBatch, used in turn
+    };
+
+    /**
+     * @brief Description of a model file, as read by inspectFile
+     */
+    struct ModelInfo
+    {
+        ModelInfo() : formatVersion(0), inputSize(0), outputSize(0), parameterCount(0), fileSize(0) {}
+
+        quint8 formatVersion;           ///< .senm format version, or 0 for JSON files
+        int inputSize;                  ///< Number of input neurons
+        int outputSize;                 ///< Number of output neurons
+        std::vector<int> hiddenSizes;   ///< Neurons in each hidden layer
+        QStringList hiddenActivations;  ///< Activation function of each hidden layer
+        QString outputActivation;       ///< Activation function of the output layer
+        QString dataPrecision;          ///< Stored precision of the weights, "json" for JSON files
+        QString compression;            ///< Compression of the weights, empty if stored raw
+        QString checksum;               ///< Checksum algorithm of the weights, empty if none
+        qint64 parameterCount;          ///< Number of weights and biases
+        qint64 fileSize;                ///< Size of the file in bytes
+        QJsonObject trainingState;      ///< Training progress saved with a checkpoint, empty if none
+    };
+
     /**
      * @brief MLP constructor with a single hidden layer (for backward compatibility)
      * @param inputSize Number of input neurons
@@ -25,10 +108,12 @@ public:
      * @param outputSize Number of output neurons
      * @param hiddenActivation Activation function for the hidden layer
      * @param outputActivation Activation function for the output layer
+     * @param seed Seed of the weight initialization, or 0 to pick one at random
      */
     MLP(int inputSize, int hiddenSize, int outputSize,
         const std::string& hiddenActivation = "sigmoid",
-        const std::string& outputActivation = "sigmoid");
+        const std::string& outputActivation = "sigmoid",
+        quint64 seed = 0);
 
     /**
      * @brief MLP constructor with multiple hidden layers
@@ -37,10 +122,39 @@ public:
      * @param outputSize Number of output neurons
      * @param hiddenActivation Activation function for all hidden layers
      * @param outputActivation Activation function for the output layer
+     * @param seed Seed of the weight initialization, or 0 to pick one at random
      */
     MLP(int inputSize, const std::vector<int>& hiddenSizes, int outputSize,
         const std::string& hiddenActivation = "sigmoid",
-        const std::string& outputActivation = "sigmoid");
+        const std::string& outputActivation = "sigmoid",
+        quint64 seed = 0);
+
+    /**
+     * @brief Load a model from a file
+     *
+     * The input size and architecture are taken from the file, and the layers
+     * are allocated without being initialized before the stored weights are
+     * read into them. Binary files are recognized by their magic number; any
+     * other file is read as JSON.
+     *
+     * @param filePath Path of a .senm or JSON model file
+     * @param map Whether to use the weights of version 3 files in place, as mapFromBinary does
+     * @return The loaded model, or nullptr on failure
+     */
+    static std::unique_ptr<MLP> fromFile(const QString& filePath, bool map = false);
+
+    /**
+     * @brief Describe a model file without loading it
+     *
+     * Only the header and metadata of a .senm file are read, so the cost
+     * does not depend on the size of the weights. JSON files are read up to
+     * the end of their architecture.
+     *
+     * @param filePath Path of a .senm or JSON model file
+     * @param info Output description
+     * @return True if successful, false if the file is not a readable model
+     */
+    static bool inspectFile(const QString& filePath, ModelInfo& info);
 
     /**
      * @brief Forward pass through the network
@@ -49,6 +163,19 @@ public:
      */
     Eigen::VectorXf forward(const Eigen::VectorXf& input);
 
+    /**
+     * @brief Forward pass that leaves the network untouched
+     *
+     * Gives the same output as forward() but keeps the activations in the
+     * context instead of the layers, so it is safe to call from several
+     * threads at once as long as the weights are not being modified.
+     *
+     * @param input Input values
+     * @param context Scratch space of the calling thread
+     * @return Output values, stored in the context until its next use
+     */
+    const Eigen::VectorXf& infer(const Eigen::VectorXf& input, InferenceContext& context) const;
+
     /**
      * @brief Train the network on a single example
      * @param input Input values
@@ -60,17 +187,80 @@ public:
 
     /**
      * @brief Preprocess an image for input to the network
+     *
+     * Safe to call from several threads at once.
+     *
      * @param image Input image
      * @return Preprocessed image as a vector
      */
-    Eigen::VectorXf preprocessImage(const QImage& image);
+    static Eigen::VectorXf preprocessImage(const QImage& image);
+
+    /**
+     * @brief Preprocess an image into existing storage, such as a column of a batch
+     * @param image Input image
+     * @param input Output values, sized to the network input
+     */
+    static void preprocessImage(const QImage& image, Eigen::Ref<Eigen::VectorXf> input);
+
+    /**
+     * @brief Preprocess an image for a network taking square inputs of another size
+     * @param image Input image
+     * @param input Output values, side x side of them
+     * @param side Side length of the network input in pixels
+     */
+    static void preprocessImage(const QImage& image, Eigen::Ref<Eigen::VectorXf> input, int side);
+
+    /**
+     * @brief Get the side length of the square images the network takes
+     * @return Side length in pixels, or 0 if the input is not a square image
+     */
+    int getInputSide() const;
+
+    /**
+     * @brief Convert an image to the grayscale input resolution of the network
+     * @param image Input image
+     * @param width Input width in pixels
+     * @param height Input height in pixels
+     * @return Grayscale8 image of the requested size
+     */
+    static QImage toInputImage(const QImage& image, int width = 512, int height = 512);
 
     /**
      * @brief Predict whether an image contains the target object
      * @param image Input image
      * @return Probability that the image contains the target object
      */
-    float predict(const QImage& image);
+    float predict(const QImage& image) const;
+
+    /**
+     * @brief Predict whether an image contains the target object, reusing scratch space
+     * @param image Input image
+     * @param context Scratch space of the calling thread; holds the activations afterwards
+     * @return Probability that the image contains the target object
+     */
+    float predict(const QImage& image, InferenceContext& context) const;
+
+    /**
+     * @brief Score a batch of preprocessed inputs
+     *
+     * Runs one matrix product per layer for the whole batch instead of one
+     * matrix-vector product per input, so each layer's weights are read once
+     * per batch. Batches of 16 to 64 inputs make the first layer, which holds
+     * nearly all of the weights, compute-bound rather than memory-bound.
+     *
+     * @param inputs One preprocessed input per column
+     * @param context Scratch space of the calling thread
+     * @return First output of the network for each input
+     */
+    Eigen::VectorXf predictBatch(const Eigen::Ref<const Eigen::MatrixXf>& inputs, InferenceContext& context) const;
+
+    /**
+     * @brief Score a batch of images
+     * @param images Input images
+     * @param context Scratch space of the calling thread; holds the preprocessed batch afterwards
+     * @return Probability that each image contains the target object
+     */
+    Eigen::VectorXf predictBatch(const QList<QImage>& images, InferenceContext& context) const;
 
     /**
      * @brief Get the layers of the network
@@ -78,6 +268,16 @@ public:
      */
     const std::vector<Layer>& getLayers() const { return layers; }
 
+    /**
+     * @brief Get the seed the weights were initialized with
+     *
+     * Constructing a network with the same architecture and seed reproduces
+     * its initial weights exactly, whatever the number of threads.
+     *
+     * @return Seed, or 0 for a network loaded from a file
+     */
+    quint64 getSeed() const { return seed; }
+
     /**
      * @brief Get the number of hidden layers
      * @return Number of hidden layers
@@ -99,33 +299,92 @@ public:
     /**
      * @brief Load the model from a JSON object
      * @param json JSON object containing the model
-     * @return True if successful, false otherwise
+     * @return True if successful, false otherwise; the model is left unchanged on failure
      */
     bool loadFromJson(const QJsonObject& json);
 
+    /**
+     * @brief Save the model to a JSON file
+     *
+     * Writes the same document as saveToJson, formatted a row at a time
+     * through a fixed-size buffer, so memory use does not grow with the size
+     * of the model. Numbers are written in the shortest form that reads back
+     * as the same float. The file is replaced atomically.
+     *
+     * @param filePath Path to save the model to
+     * @return True if successful, false otherwise
+     */
+    bool saveToJsonFile(const QString& filePath) const;
+
+    /**
+     * @brief Load the model from a JSON file
+     *
+     * The file is parsed incrementally and each number is stored straight
+     * into its layer, so no document tree is built. Files whose architecture
+     * does not come first are loaded through loadFromJson instead.
+     *
+     * @param filePath Path to load the model from
+     * @return True if successful, false otherwise; the model is left unchanged on failure
+     */
+    bool loadFromJsonFile(const QString& filePath);
+
     /**
      * @brief Save the model to a binary file
      * @param filePath Path to save the model to
+     * @param options Format options
      * @return True if successful, false otherwise
      */
-    bool saveToBinary(const QString& filePath) const;
+    bool saveToBinary(const QString& filePath, const BinaryOptions& options = BinaryOptions()) const;
 
     /**
      * @brief Load the model from a binary file
      * @param filePath Path to load the model from
-     * @return True if successful, false otherwise
+     * @return True if successful, false otherwise; the model is left unchanged on failure
      */
     bool loadFromBinary(const QString& filePath);
 
+    /**
+     * @brief Load the model from a binary file, using its weights in place
+     *
+     * Version 3 files are memory-mapped and the layers read their weights
+     * straight from the mapping, so loading costs little more than parsing
+     * the metadata and processes using the same file share its pages. A layer
+     * copies its weights the first time it is trained. Older versions, and
+     * hosts that cannot map the file, are loaded as by loadFromBinary.
+     * Checksums are verified in parallel before returning, which reads the
+     * mapped weights once.
+     *
+     * @param filePath Path to load the model from
+     * @return True if successful, false otherwise; the model is left unchanged on failure
+     */
+    bool mapFromBinary(const QString& filePath);
+
 private:
     // Constants for binary file format
     static const quint32 MAGIC_NUMBER = 0x4D4E4553; // "SENM" in little-endian (S E N M)
     static const quint32 MAGIC_NUMBER_REVERSED = 0x53454E4D; // "SENM" in big-endian (M N E S)
     static const quint8 FORMAT_VERSION = 0x02; // Incremented to support multiple hidden layers
+    static const quint8 FORMAT_VERSION_ALIGNED = 0x03; // Aligned weight blocks for memory mapping
     std::vector<Layer> layers;
     int inputSize;
     int outputSize;
     std::vector<int> hiddenSizes; // Store sizes of all hidden layers
+    quint64 seed; // Seed of the weight initialization
+
+    /**
+     * @brief Construct an empty network for fromFile
+     *
+     * The input and output sizes are zero until a file is loaded, which
+     * makes createLayers take them from the file.
+     */
+    MLP();
+
+    /**
+     * @brief Initialize the weights of all layers from the seed
+     *
+     * Picks a random seed first if none was given.
+     */
+    void initializeLayers();
 
     /**
      * @brief Calculate the loss for a single example
@@ -142,6 +401,129 @@ private:
      * @return Gradient of the loss function
      */
     Eigen::VectorXf calculateLossGradient(const Eigen::VectorXf& output, const Eigen::VectorXf& target) const;
+
+    /**
+     * @brief Describe the layer structure for model files
+     * @return Architecture object as stored in JSON and binary model files
+     */
+    QJsonObject architectureToJson() const;
+
+    /**
+     * @brief Recreate the layers from a stored architecture
+     *
+     * The new layers are left uninitialized for the caller to fill in.
+     *
+     * @param architecture Architecture object from a model file
+     * @return True if successful, false if it is invalid or does not match this network's input and output sizes
+     */
+    bool createLayers(const QJsonObject& architecture);
+
+    /**
+     * @brief Read the magic number, format version and metadata of a binary model file
+     * @param file File positioned at the start; left positioned after the metadata
+     * @param formatVersion Output format version
+     * @param metadata Output metadata
+     * @return True if successful, false otherwise
+     */
+    static bool readBinaryHeader(QFile& file, quint8& formatVersion, QJsonObject& metadata);
+
+    /**
+     * @brief Read the weights and biases of all layers from a binary model file
+     * @param stream Stream positioned at the first weight
+     * @return True if successful, false otherwise
+     */
+    bool readLayers(QDataStream& stream);
+
+    /**
+     * @brief Read the weights and biases of all layers from a version 3 file
+     * @param file Open model file
+     * @param metadata Metadata of the file
+     * @param metadataEnd Offset of the first byte after the metadata
+     * @param map Whether to use the blocks in place instead of copying them
+     * @return True if successful, false otherwise
+     */
+    bool readAlignedLayers(const std::shared_ptr<QFile>& file, const QJsonObject& metadata,
+                           qint64 metadataEnd, bool map);
+
+    /**
+     * @brief Write the chunk index and compressed chunks of a compressed version 3 file
+     * @param file File positioned at indexOffset
+     * @param indexOffset Offset of the chunk index
+     * @param chunkFloats Number of floats per chunk
+     * @param level zlib compression level
+     * @return True if successful, false otherwise
+     */
+    bool writeCompressedLayers(QFileDevice& file, qint64 indexOffset, qint64 chunkFloats, int level) const;
+
+    /**
+     * @brief Read the weights and biases of all layers from a compressed version 3 file
+     * @param file Open model file
+     * @param metadata Metadata of the file
+     * @param payloadStart Offset of the chunk index
+     * @return True if successful, false otherwise
+     */
+    bool readCompressedLayers(const std::shared_ptr<QFile>& file, const QJsonObject& metadata, qint64 payloadStart);
+
+    /**
+     * @brief Load the model from a binary file
+     * @param filePath Path to load the model from
+     * @param map Whether to map version 3 files instead of reading them
+     * @return True if successful, false otherwise
+     */
+    bool loadBinary(const QString& filePath, bool map);
+
+    /**
+     * @brief Load the model from a JSON object into this network's layers
+     * @param json JSON object containing the model
+     * @return True if successful, false otherwise
+     */
+    bool readJson(const QJsonObject& json);
+
+    /**
+     * @brief Load the model from a JSON file into this network's layers
+     * @param filePath Path to load the model from
+     * @return True if successful, false otherwise
+     */
+    bool readJsonFile(const QString& filePath);
+
+    /**
+     * @brief Load into a separate network and take it over only if that succeeds
+     *
+     * The loaders replace the layers before the weights are read and
+     * checked, so a short read or a checksum mismatch would otherwise leave
+     * this network half overwritten.
+     *
+     * @param load Loader run on a network with this one's input and output sizes
+     * @return True if the load succeeded and this network was replaced
+     */
+    bool loadReplacing(const std::function<bool(MLP&)>& load);
+
+    /**
+     * @brief Count the weights and biases of all layers
+     * @return Number of parameters
+     */
+    qint64 parameterCount() const;
+
+    /**
+     * @brief Whether a chunk size read from a binary model file can be used
+     * @param chunkFloats Number of floats per chunk
+     * @return True if it is positive and no larger than the parameters, false otherwise
+     */
+    bool isValidChunkSize(qint64 chunkFloats) const;
+
+    /**
+     * @brief Split the weights and biases of all layers into the chunks of binary model files
+     * @param chunkFloats Number of floats per chunk, at least one
+     * @return (data, count) pairs in file order
+     */
+    std::vector<std::pair<const float*, qint64>> parameterChunks(qint64 chunkFloats) const;
+
+    /**
+     * @brief Check the weights and biases against the checksums of a binary model file
+     * @param metadata Metadata of the file
+     * @return True if they match or the file has no checksums, false otherwise
+     */
+    bool verifyChecksums(const QJsonObject& metadata) const;
 };
 
 #endif // MLP_H
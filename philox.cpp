@@ -0,0 +1,103 @@
+#include "philox.h"
+#include <QThreadPool>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Round multipliers and key increments of Philox4x32
+const std::uint32_t MULTIPLIER_0 = 0xD2511F53;
+const std::uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+const std::uint32_t KEY_INCREMENT_0 = 0x9E3779B9;
+const std::uint32_t KEY_INCREMENT_1 = 0xBB67AE85;
+const int ROUNDS = 10;
+
+// Values per task when filling in parallel; a multiple of every batch size
+const std::int64_t FILL_BLOCK = 1 << 18;
+
+} // namespace
+
+Philox4x32::Philox4x32(std::uint64_t seed)
+{
+    key[0] = static_cast<std::uint32_t>(seed);
+    key[1] = static_cast<std::uint32_t>(seed >> 32);
+}
+
+void Philox4x32::generate(std::uint64_t counter, std::uint64_t stream, std::uint32_t output[4]) const
+{
+    std::uint32_t batch[BATCH * 4];
+    generateBatch(counter, stream, batch);
+    std::memcpy(output, batch, 4 * sizeof(std::uint32_t));
+}
+
+void Philox4x32::generateBatch(std::uint64_t counter, std::uint64_t stream, std::uint32_t output[BATCH * 4]) const
+{
+    // One array per counter word, so each round is the same operation on
+    // every lane
+    std::uint32_t c0[BATCH];
+    std::uint32_t c1[BATCH];
+    std::uint32_t c2[BATCH];
+    std::uint32_t c3[BATCH];
+    for (int lane = 0; lane < BATCH; ++lane) {
+        c0[lane] = static_cast<std::uint32_t>(counter + lane);
+        c1[lane] = static_cast<std::uint32_t>((counter + lane) >> 32);
+        c2[lane] = static_cast<std::uint32_t>(stream);
+        c3[lane] = static_cast<std::uint32_t>(stream >> 32);
+    }
+
+    std::uint32_t k0 = key[0];
+    std::uint32_t k1 = key[1];
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (int lane = 0; lane < BATCH; ++lane) {
+            const std::uint64_t p0 = static_cast<std::uint64_t>(MULTIPLIER_0) * c0[lane];
+            const std::uint64_t p1 = static_cast<std::uint64_t>(MULTIPLIER_1) * c2[lane];
+            const std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1[lane] ^ k0;
+            const std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3[lane] ^ k1;
+            c1[lane] = static_cast<std::uint32_t>(p1);
+            c3[lane] = static_cast<std::uint32_t>(p0);
+            c0[lane] = n0;
+            c2[lane] = n2;
+        }
+        k0 += KEY_INCREMENT_0;
+        k1 += KEY_INCREMENT_1;
+    }
+
+    for (int lane = 0; lane < BATCH; ++lane) {
+        output[lane * 4] = c0[lane];
+        output[lane * 4 + 1] = c1[lane];
+        output[lane * 4 + 2] = c2[lane];
+        output[lane * 4 + 3] = c3[lane];
+    }
+}
+
+void Philox4x32::fillUniform(float* data, std::int64_t count, float low, float high,
+                             std::uint64_t seed, std::uint32_t stream)
+{
+    const Philox4x32 generator(seed);
+    const float scale = (high - low) / 16777216.0f;
+
+    // Fill [first, last); first is a multiple of the batch size
+    auto fill = [&generator, data, low, scale, stream](std::int64_t first, std::int64_t last) {
+        std::uint32_t numbers[BATCH * 4];
+        for (std::int64_t i = first; i < last; i += BATCH * 4) {
+            generator.generateBatch(static_cast<std::uint64_t>(i / 4), stream, numbers);
+            const int n = static_cast<int>(std::min<std::int64_t>(BATCH * 4, last - i));
+            for (int j = 0; j < n; ++j) {
+                // The top 24 bits give every float in [0, 1) with a spacing of 2^-24
+                data[i + j] = low + static_cast<float>(numbers[j] >> 8) * scale;
+            }
+        }
+    };
+
+    if (count <= FILL_BLOCK) {
+        fill(0, count);
+        return;
+    }
+
+    QThreadPool pool;
+    for (std::int64_t first = 0; first < count; first += FILL_BLOCK) {
+        const std::int64_t last = std::min(count, first + FILL_BLOCK);
+        pool.start([&fill, first, last]() { fill(first, last); });
+    }
+    pool.waitForDone();
+}
@@ -0,0 +1,64 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+
+/**
+ * @brief The Philox4x32 class is a counter-based random number generator
+ *
+ * Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2,
+ * 3") turns a 128-bit counter and a 64-bit key into four 32-bit random
+ * numbers. There is no state carried from one output to the next, so any
+ * part of a sequence can be generated on its own: a large array can be
+ * filled by any number of threads, in any order, and still receive exactly
+ * the same values.
+ */
+class Philox4x32
+{
+public:
+    /**
+     * @brief Philox4x32 constructor
+     * @param seed Key of the generator
+     */
+    explicit Philox4x32(std::uint64_t seed);
+
+    /**
+     * @brief Generate the four numbers of one counter
+     *
+     * The 128-bit counter of the cipher is the position in its low half and
+     * the stream in its high half.
+     *
+     * @param counter Position in the sequence
+     * @param stream Independent sequence under the same seed
+     * @param output Output numbers
+     */
+    void generate(std::uint64_t counter, std::uint64_t stream, std::uint32_t output[4]) const;
+
+    /**
+     * @brief Fill an array with uniformly distributed floats
+     *
+     * Element i is taken from counter i / 4, so the result depends only on
+     * the seed and the stream, not on how the work is split. Large arrays
+     * are filled in parallel.
+     *
+     * @param data Output values
+     * @param count Number of values
+     * @param low Lower bound, inclusive
+     * @param high Upper bound, exclusive
+     * @param seed Key of the generator
+     * @param stream Independent sequence under the same seed
+     */
+    static void fillUniform(float* data, std::int64_t count, float low, float high,
+                            std::uint64_t seed, std::uint32_t stream);
+
+private:
+    // Counters generated together, laid out so the rounds vectorize
+    static const int BATCH = 8;
+
+    std::uint32_t key[2];
+
+    // Generate BATCH consecutive counters starting at counter, four numbers each
+    void generateBatch(std::uint64_t counter, std::uint64_t stream, std::uint32_t output[BATCH * 4]) const;
+};
+
+#endif // PHILOX_H
@@ -16,15 +16,33 @@ SOURCES += \
     main.cpp \
     mainwindow.cpp \
     mlp.cpp \
+    cascade.cpp \
     layer.cpp \
+    philox.cpp \
+    crc32c.cpp \
     trainingworker.cpp \
+    datasetstore.cpp \
+    augmentationstage.cpp \
+    imagescanner.cpp \
+    thumbnailcache.cpp \
+    checkpointwriter.cpp \
+    jsonstream.cpp \
     losscurvewidget.cpp
 
 HEADERS += \
     mainwindow.h \
     mlp.h \
+    cascade.h \
     layer.h \
+    philox.h \
+    crc32c.h \
     trainingworker.h \
+    datasetstore.h \
+    augmentationstage.h \
+    imagescanner.h \
+    thumbnailcache.h \
+    checkpointwriter.h \
+    jsonstream.h \
     losscurvewidget.h
 
 FORMS += \
@@ -0,0 +1,368 @@
+#include "mlp.h"
+#include "cascade.h"
+#include "datasetstore.h"
+#include "trainingworker.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QDebug>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Images decoded and scored together by one pool task
+const qsizetype CALIBRATION_BATCH = 32;
+
+// Hidden layer sizes from a comma-separated list such as "32,16"
+bool parseHiddenSizes(const QString& text, std::vector<int>& sizes)
+{
+    sizes.clear();
+    for (const QString& part : text.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int size = part.trimmed().toInt(&ok);
+        if (!ok || size <= 0) {
+            return false;
+        }
+        sizes.push_back(size);
+    }
+    return !sizes.empty();
+}
+
+// Scores of one evaluation image
+struct Sample
+{
+    bool positive = false;
+    bool decoded = false;
+    float screen = 0.0f;
+    float full = 0.0f;
+};
+
+// Score at which the allowed share of the sorted scores lies beyond, or fallback if there are none
+float cutoff(std::vector<float> scores, double keep, bool ascending, float fallback)
+{
+    if (scores.empty()) {
+        return fallback;
+    }
+    if (ascending) {
+        std::sort(scores.begin(), scores.end());
+    } else {
+        std::sort(scores.begin(), scores.end(), std::greater<float>());
+    }
+    const size_t allowed = static_cast<size_t>((1.0 - keep) * scores.size());
+    return scores[std::min(allowed, scores.size() - 1)];
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-cascade");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Train a small screening model and pick the scores at which it can decide "
+                                     "without the full model, keeping the full model's recall on evaluation images.");
+    parser.addHelpOption();
+
+    QCommandLineOption fullOption(QStringList() << "full", "Full model file (.senm or JSON).", "file");
+    QCommandLineOption screenOption(QStringList() << "screen",
+                                    "Screening model to calibrate instead of training one.", "file");
+    QCommandLineOption positiveOption(QStringList() << "p" << "positive", "Directory with positive training examples.", "dir");
+    QCommandLineOption negativeOption(QStringList() << "n" << "negative", "Directory with negative training examples.", "dir");
+    QCommandLineOption packOption(QStringList() << "pack",
+                                  "Packed dataset at the screening resolution to train on instead.", "file");
+    QCommandLineOption evalPositiveOption(QStringList() << "eval-positive",
+                                         "Directory with positive evaluation examples.", "dir");
+    QCommandLineOption evalNegativeOption(QStringList() << "eval-negative",
+                                          "Directory with negative evaluation examples.", "dir");
+    QCommandLineOption screenOutputOption(QStringList() << "screen-output", "Screening model file to write.", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Cascade file to write.", "file");
+    QCommandLineOption sideOption(QStringList() << "side", "Side length of the screening input in pixels.",
+                                  "pixels", "64");
+    QCommandLineOption hiddenOption(QStringList() << "hidden", "Screening hidden layer sizes, comma separated.",
+                                    "sizes", "32");
+    QCommandLineOption activationOption(QStringList() << "activation", "Hidden activation: sigmoid, relu or tanh.",
+                                        "name", "relu");
+    QCommandLineOption learningRateOption(QStringList() << "r" << "learning-rate", "Learning rate.", "rate", "0.01");
+    QCommandLineOption epochsOption(QStringList() << "e" << "epochs", "Number of epochs.", "count", "50");
+    QCommandLineOption batchSizeOption(QStringList() << "b" << "batch-size", "Batch size.", "size", "10");
+    QCommandLineOption seedOption(QStringList() << "seed",
+                                  "Seed of the weight initialization and shuffle, 0 for a random one.", "seed", "0");
+    QCommandLineOption keepRecallOption(QStringList() << "keep-recall",
+                                        "Share of the full model's true positives the cascade must keep.",
+                                        "fraction", "1.0");
+    QCommandLineOption keepSpecificityOption(QStringList() << "keep-specificity",
+                                             "Share of the full model's true negatives the cascade must keep.",
+                                             "fraction", "1.0");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of threads, 0 for one per core.",
+                                     "count", "0");
+    parser.addOption(fullOption);
+    parser.addOption(screenOption);
+    parser.addOption(positiveOption);
+    parser.addOption(negativeOption);
+    parser.addOption(packOption);
+    parser.addOption(evalPositiveOption);
+    parser.addOption(evalNegativeOption);
+    parser.addOption(screenOutputOption);
+    parser.addOption(outputOption);
+    parser.addOption(sideOption);
+    parser.addOption(hiddenOption);
+    parser.addOption(activationOption);
+    parser.addOption(learningRateOption);
+    parser.addOption(epochsOption);
+    parser.addOption(batchSizeOption);
+    parser.addOption(seedOption);
+    parser.addOption(keepRecallOption);
+    parser.addOption(keepSpecificityOption);
+    parser.addOption(threadsOption);
+    parser.process(app);
+
+    const bool training = !parser.isSet(screenOption);
+    if (!parser.isSet(fullOption) || !parser.isSet(evalPositiveOption) || !parser.isSet(evalNegativeOption) ||
+        !parser.isSet(outputOption) ||
+        (training && (!parser.isSet(screenOutputOption) ||
+                      (!parser.isSet(positiveOption) && !parser.isSet(packOption))))) {
+        qCritical() << "--full, --eval-positive, --eval-negative and --output are required, and either --screen "
+                       "or --screen-output with --positive or --pack.";
+        parser.showHelp(1);
+    }
+
+    std::vector<int> hiddenSizes;
+    if (!parseHiddenSizes(parser.value(hiddenOption), hiddenSizes)) {
+        qCritical() << "Invalid hidden layer sizes:" << parser.value(hiddenOption);
+        return 1;
+    }
+    const QString activation = parser.value(activationOption);
+    if (activation != "sigmoid" && activation != "relu" && activation != "tanh") {
+        qCritical() << "Unknown activation:" << activation;
+        return 1;
+    }
+
+    bool ok[8];
+    const int side = parser.value(sideOption).toInt(&ok[0]);
+    const float learningRate = parser.value(learningRateOption).toFloat(&ok[1]);
+    const int epochs = parser.value(epochsOption).toInt(&ok[2]);
+    const int batchSize = parser.value(batchSizeOption).toInt(&ok[3]);
+    const quint64 seed = parser.value(seedOption).toULongLong(&ok[4]);
+    const double keepRecall = parser.value(keepRecallOption).toDouble(&ok[5]);
+    const double keepSpecificity = parser.value(keepSpecificityOption).toDouble(&ok[6]);
+    const int threads = parser.value(threadsOption).toInt(&ok[7]);
+    for (bool valid : ok) {
+        if (!valid) {
+            qCritical() << "Numeric options must be numbers.";
+            return 1;
+        }
+    }
+    if (side <= 0 || learningRate <= 0.0f || epochs <= 0 || batchSize <= 0 || threads < 0 ||
+        keepRecall < 0.0 || keepRecall > 1.0 || keepSpecificity < 0.0 || keepSpecificity > 1.0) {
+        qCritical() << "Option out of range.";
+        return 1;
+    }
+
+    std::unique_ptr<const MLP> full = MLP::fromFile(parser.value(fullOption), true);
+    if (!full) {
+        qCritical() << "Failed to load full model" << parser.value(fullOption);
+        return 1;
+    }
+
+    // Train the screening model as sensuser-train would, at the screening resolution
+    QString screenPath = parser.value(screenOption);
+    std::unique_ptr<MLP> screen;
+    if (training) {
+        screen = std::make_unique<MLP>(side * side, hiddenSizes, 1, activation.toStdString(), "sigmoid", seed);
+
+        TrainingWorker worker(screen.get());
+        worker.setPositiveDir(parser.value(positiveOption));
+        worker.setNegativeDir(parser.value(negativeOption));
+        worker.setPackFile(parser.value(packOption));
+        worker.setLearningRate(learningRate);
+        worker.setEpochs(epochs);
+        worker.setBatchSize(batchSize);
+        worker.setShuffleSeed(seed);
+        worker.setThreadCount(threads);
+
+        bool failed = false;
+        QObject::connect(&worker, &TrainingWorker::progressUpdated, [](int epoch, int totalEpochs, float loss) {
+            qDebug().noquote() << QString("screening epoch %1/%2  loss %3").arg(epoch).arg(totalEpochs).arg(loss, 0, 'f', 6);
+        });
+        QObject::connect(&worker, &TrainingWorker::trainingFailed, [&failed](const QString& reason) {
+            qCritical().noquote() << reason;
+            failed = true;
+        });
+        worker.train();
+        if (failed) {
+            return 1;
+        }
+
+        screenPath = parser.value(screenOutputOption);
+        if (!screen->saveToBinary(screenPath)) {
+            qCritical() << "Failed to write" << screenPath;
+            return 1;
+        }
+    } else {
+        screen = MLP::fromFile(screenPath, true);
+        if (!screen) {
+            qCritical() << "Failed to load screening model" << screenPath;
+            return 1;
+        }
+    }
+
+    const Cascade check(*screen, *full, CascadeThresholds());
+    if (!check.isValid()) {
+        qCritical() << "The screening model does not take smaller square images than the full model";
+        return 1;
+    }
+    const int screenSide = screen->getInputSide();
+    const int fullSide = full->getInputSide();
+
+    // Score every evaluation image with both models, decoding it once
+    const QStringList positiveFiles = DatasetStore::imageFiles(parser.value(evalPositiveOption));
+    const QStringList files = positiveFiles + DatasetStore::imageFiles(parser.value(evalNegativeOption));
+    if (positiveFiles.isEmpty() || files.size() == positiveFiles.size()) {
+        qCritical() << "Evaluation needs both positive and negative images.";
+        return 1;
+    }
+
+    std::vector<Sample> samples(static_cast<size_t>(files.size()));
+    QAtomicInteger<qint64> screenNs = 0;
+    QAtomicInteger<qint64> fullNs = 0;
+    QThreadPool pool;
+    if (threads > 0) {
+        pool.setMaxThreadCount(threads);
+    }
+    for (qsizetype first = 0; first < files.size(); first += CALIBRATION_BATCH) {
+        const qsizetype last = std::min(files.size(), first + CALIBRATION_BATCH);
+        pool.start([&, first, last]() {
+            thread_local MLP::InferenceContext context;
+            thread_local Eigen::MatrixXf screenBatch;
+            thread_local Eigen::MatrixXf fullBatch;
+
+            std::vector<QImage> images;
+            std::vector<qsizetype> decoded;
+            for (qsizetype i = first; i < last; ++i) {
+                samples[static_cast<size_t>(i)].positive = i < positiveFiles.size();
+                QImageReader reader(files.at(i));
+                QImage image = reader.read();
+                if (image.isNull()) {
+                    qWarning() << "Failed to load image:" << files.at(i) << reader.errorString();
+                    continue;
+                }
+                images.push_back(image);
+                decoded.push_back(i);
+            }
+            if (decoded.empty()) {
+                return;
+            }
+            const Eigen::Index count = static_cast<Eigen::Index>(decoded.size());
+
+            // Each model is timed with its own preprocessing, as the cascade runs them
+            QElapsedTimer timer;
+            timer.start();
+            screenBatch.resize(screenSide * screenSide, count);
+            for (Eigen::Index j = 0; j < count; ++j) {
+                MLP::preprocessImage(images[static_cast<size_t>(j)], screenBatch.col(j), screenSide);
+            }
+            const Eigen::VectorXf screenScores = screen->predictBatch(screenBatch, context);
+            screenNs.fetchAndAddRelaxed(timer.nsecsElapsed());
+
+            timer.restart();
+            fullBatch.resize(fullSide * fullSide, count);
+            for (Eigen::Index j = 0; j < count; ++j) {
+                MLP::preprocessImage(images[static_cast<size_t>(j)], fullBatch.col(j), fullSide);
+            }
+            const Eigen::VectorXf fullScores = full->predictBatch(fullBatch, context);
+            fullNs.fetchAndAddRelaxed(timer.nsecsElapsed());
+
+            for (Eigen::Index j = 0; j < count; ++j) {
+                Sample& sample = samples[static_cast<size_t>(decoded[static_cast<size_t>(j)])];
+                sample.decoded = true;
+                sample.screen = screenScores(j);
+                sample.full = fullScores(j);
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // Reject below the screening score that keeps the required share of the
+    // full model's true positives, and accept above the one that keeps the
+    // required share of its true negatives
+    std::vector<float> truePositiveScreens;
+    std::vector<float> trueNegativeScreens;
+    int scored = 0;
+    for (const Sample& sample : samples) {
+        if (!sample.decoded) {
+            continue;
+        }
+        ++scored;
+        if (sample.positive && sample.full >= 0.5f) {
+            truePositiveScreens.push_back(sample.screen);
+        } else if (!sample.positive && sample.full < 0.5f) {
+            trueNegativeScreens.push_back(sample.screen);
+        }
+    }
+    if (scored == 0) {
+        qCritical() << "No evaluation image could be decoded.";
+        return 1;
+    }
+
+    // Outside the band the screening score is the result, so the band has
+    // to contain 0.5 for its verdict to agree with the thresholds
+    CascadeThresholds thresholds;
+    thresholds.rejectBelow = std::min(cutoff(truePositiveScreens, keepRecall, true, 0.0f), 0.5f);
+    thresholds.acceptAbove = std::max(cutoff(trueNegativeScreens, keepSpecificity, false, 1.0f), 0.5f);
+
+    // Replay the cascade on the scores just computed
+    int escalated = 0;
+    int fullTruePositives = 0;
+    int cascadeTruePositives = 0;
+    int fullCorrect = 0;
+    int cascadeCorrect = 0;
+    const Cascade cascade(*screen, *full, thresholds);
+    for (const Sample& sample : samples) {
+        if (!sample.decoded) {
+            continue;
+        }
+        const bool uncertain = cascade.isUncertain(sample.screen);
+        escalated += uncertain ? 1 : 0;
+        const bool fullPositive = sample.full >= 0.5f;
+        const bool cascadePositive = (uncertain ? sample.full : sample.screen) >= 0.5f;
+        fullTruePositives += sample.positive && fullPositive ? 1 : 0;
+        cascadeTruePositives += sample.positive && cascadePositive ? 1 : 0;
+        fullCorrect += sample.positive == fullPositive ? 1 : 0;
+        cascadeCorrect += sample.positive == cascadePositive ? 1 : 0;
+    }
+
+    CascadeFile cascadeFile;
+    cascadeFile.screenPath = QFileInfo(screenPath).absoluteFilePath();
+    cascadeFile.fullPath = QFileInfo(parser.value(fullOption)).absoluteFilePath();
+    cascadeFile.thresholds = thresholds;
+    if (!cascadeFile.write(parser.value(outputOption))) {
+        qCritical() << "Failed to write" << parser.value(outputOption);
+        return 1;
+    }
+
+    const double screenMs = screenNs.loadRelaxed() / 1e6 / scored;
+    const double fullMs = fullNs.loadRelaxed() / 1e6 / scored;
+    const double escalatedShare = static_cast<double>(escalated) / scored;
+    const double cascadeMs = screenMs + escalatedShare * fullMs;
+    qDebug().noquote() << QString("Band: reject below %1, accept above %2")
+                              .arg(thresholds.rejectBelow, 0, 'g', 6).arg(thresholds.acceptAbove, 0, 'g', 6);
+    qDebug().noquote() << QString("Full model used for %1 of %2 images (%3%)")
+                              .arg(escalated).arg(scored).arg(escalatedShare * 100.0, 0, 'f', 1);
+    qDebug().noquote() << QString("True positives: full %1, cascade %2; accuracy: full %3%, cascade %4%")
+                              .arg(fullTruePositives).arg(cascadeTruePositives)
+                              .arg(100.0 * fullCorrect / scored, 0, 'f', 2).arg(100.0 * cascadeCorrect / scored, 0, 'f', 2);
+    qDebug().noquote() << QString("Preprocess and score per image: screen %1 ms, full %2 ms, cascade %3 ms (%4x)")
+                              .arg(screenMs, 0, 'f', 3).arg(fullMs, 0, 'f', 3).arg(cascadeMs, 0, 'f', 3)
+                              .arg(fullMs / qMax(cascadeMs, 1e-9), 0, 'f', 1);
+    qDebug() << "Cascade written to" << parser.value(outputOption);
+
+    return 0;
+}
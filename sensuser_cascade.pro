@@ -0,0 +1,33 @@
+QT += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += /usr/local/include/Eigen
+
+SOURCES += \
+    sensuser_cascade.cpp \
+    trainingworker.cpp \
+    datasetstore.cpp \
+    augmentationstage.cpp \
+    checkpointwriter.cpp \
+    mlp.cpp \
+    cascade.cpp \
+    layer.cpp \
+    philox.cpp \
+    crc32c.cpp \
+    jsonstream.cpp
+
+HEADERS += \
+    trainingworker.h \
+    datasetstore.h \
+    augmentationstage.h \
+    checkpointwriter.h \
+    mlp.h \
+    cascade.h \
+    layer.h \
+    philox.h \
+    crc32c.h \
+    jsonstream.h
+
+TARGET = sensuser-cascade
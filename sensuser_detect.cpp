@@ -0,0 +1,168 @@
+#include "mlp.h"
+#include "slidingwindowdetector.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImageReader>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Pyramid scales from a comma-separated list such as "1,1.5,2"
+bool parseScales(const QString& text, std::vector<double>& scales)
+{
+    scales.clear();
+    for (const QString& part : text.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const double scale = part.trimmed().toDouble(&ok);
+        if (!ok || scale <= 0.0) {
+            return false;
+        }
+        scales.push_back(scale);
+    }
+    return !scales.empty();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-detect");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Slide a window over an image larger than the model input and score "
+                                     "every window, writing the windows and a heatmap.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("image", "Image to scan.");
+
+    QCommandLineOption modelOption(QStringList() << "m" << "model", "Model file (.senm or JSON).", "file");
+    QCommandLineOption windowOption(QStringList() << "w" << "window", "Window side in pixels at scale 1.", "pixels", "512");
+    QCommandLineOption strideOption(QStringList() << "s" << "stride", "Step between windows in pixels at scale 1.",
+                                    "pixels", "256");
+    QCommandLineOption scalesOption(QStringList() << "scales", "Pyramid scales multiplying window and stride, comma separated.",
+                                    "scales", "1");
+    QCommandLineOption thresholdOption(QStringList() << "t" << "threshold", "Score at or above which a window is listed.",
+                                       "score", "0.5");
+    QCommandLineOption heatmapOption(QStringList() << "heatmap", "PNG file to write the heatmap to.", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "File to write the listed windows to as JSON lines, standard output if not set.", "file");
+    QCommandLineOption batchSizeOption(QStringList() << "b" << "batch-size", "Windows scored together by one thread.",
+                                       "count", "32");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of threads, 0 for one per core.",
+                                     "count", "0");
+    parser.addOption(modelOption);
+    parser.addOption(windowOption);
+    parser.addOption(strideOption);
+    parser.addOption(scalesOption);
+    parser.addOption(thresholdOption);
+    parser.addOption(heatmapOption);
+    parser.addOption(outputOption);
+    parser.addOption(batchSizeOption);
+    parser.addOption(threadsOption);
+    parser.process(app);
+
+    if (!parser.isSet(modelOption) || parser.positionalArguments().size() != 1) {
+        qCritical() << "--model and one image are required.";
+        parser.showHelp(1);
+    }
+
+    SlidingWindowOptions options;
+    if (!parseScales(parser.value(scalesOption), options.scales)) {
+        qCritical() << "Invalid scales:" << parser.value(scalesOption);
+        return 1;
+    }
+    bool ok[5];
+    options.windowSize = parser.value(windowOption).toInt(&ok[0]);
+    options.stride = parser.value(strideOption).toInt(&ok[1]);
+    options.batchSize = parser.value(batchSizeOption).toInt(&ok[2]);
+    options.threadCount = parser.value(threadsOption).toInt(&ok[3]);
+    const float threshold = parser.value(thresholdOption).toFloat(&ok[4]);
+    for (bool valid : ok) {
+        if (!valid) {
+            qCritical() << "Numeric options must be numbers.";
+            return 1;
+        }
+    }
+    if (options.windowSize <= 0 || options.stride <= 0 || options.batchSize <= 0 || options.threadCount < 0) {
+        qCritical() << "Option out of range.";
+        return 1;
+    }
+
+    std::unique_ptr<const MLP> model = MLP::fromFile(parser.value(modelOption), true);
+    if (!model) {
+        qCritical() << "Failed to load model" << parser.value(modelOption);
+        return 1;
+    }
+
+    const QString imagePath = parser.positionalArguments().first();
+    QImageReader reader(imagePath);
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        qCritical() << "Failed to load image:" << imagePath << reader.errorString();
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    SlidingWindowDetector detector(*model, options);
+    std::vector<WindowScore> windows;
+    if (!detector.detect(image, windows)) {
+        return 1;
+    }
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    qDebug().noquote() << QString("Scored %1 windows in %2 s, %3 windows/s")
+                              .arg(windows.size()).arg(seconds, 0, 'f', 2)
+                              .arg(windows.size() / qMax(seconds, 1e-9), 0, 'f', 1);
+
+    if (parser.isSet(heatmapOption)) {
+        // Cells no larger than the smallest stride, so neighbouring windows stay apart
+        const double smallestScale = *std::min_element(options.scales.begin(), options.scales.end());
+        const int cellSize = qMax(1, static_cast<int>(options.stride * qMin(1.0, smallestScale)));
+        const Eigen::MatrixXf map = SlidingWindowDetector::heatmap(windows, image.size(), cellSize);
+        if (!SlidingWindowDetector::heatmapImage(map, image.size()).save(parser.value(heatmapOption), "PNG")) {
+            qCritical() << "Failed to write" << parser.value(heatmapOption);
+            return 1;
+        }
+    }
+
+    QFile outputFile;
+    bool opened;
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        opened = outputFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    } else {
+        opened = outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    if (!opened) {
+        qCritical() << "Failed to open output" << parser.value(outputOption);
+        return 1;
+    }
+
+    // Highest scores first
+    std::sort(windows.begin(), windows.end(),
+              [](const WindowScore& a, const WindowScore& b) { return a.score > b.score; });
+    QTextStream out(&outputFile);
+    for (const WindowScore& window : windows) {
+        if (window.score < threshold) {
+            break;
+        }
+        QJsonObject json;
+        json["x"] = window.rect.x();
+        json["y"] = window.rect.y();
+        json["size"] = window.rect.width();
+        json["scale"] = window.scale;
+        json["score"] = window.score;
+        out << QJsonDocument(json).toJson(QJsonDocument::Compact) << '\n';
+    }
+    out.flush();
+
+    return 0;
+}
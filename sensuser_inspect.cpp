@@ -0,0 +1,169 @@
+#include "mlp.h"
+#include "jsonstream.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Layer sizes from input to output, e.g. "262144-128-1"
+QString layerSizes(const MLP::ModelInfo& info)
+{
+    QStringList sizes;
+    sizes << QString::number(info.inputSize);
+    for (int size : info.hiddenSizes) {
+        sizes << QString::number(size);
+    }
+    sizes << QString::number(info.outputSize);
+    return sizes.join("-");
+}
+
+// Whether a JSON file is a model file; model files start with their
+// architecture, while other JSON such as cascade files does not
+bool isModelJson(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    JsonStreamReader reader(&file);
+    QString key;
+    return reader.beginObject() && reader.nextKey(key) && key == "architecture";
+}
+
+QString formatName(const MLP::ModelInfo& info)
+{
+    if (info.formatVersion == 0) {
+        return "json";
+    }
+    QString name = QString("v%1").arg(info.formatVersion);
+    if (!info.compression.isEmpty()) {
+        name += "+" + info.compression;
+    }
+    return name;
+}
+
+QJsonObject toJson(const QString& filePath, const MLP::ModelInfo& info)
+{
+    QJsonObject json;
+    json["path"] = filePath;
+    json["format"] = formatName(info);
+    json["input_neurons"] = info.inputSize;
+    json["output_neurons"] = info.outputSize;
+
+    QJsonArray hiddenLayers;
+    for (size_t i = 0; i < info.hiddenSizes.size(); ++i) {
+        QJsonObject hiddenLayer;
+        hiddenLayer["neurons"] = info.hiddenSizes[i];
+        hiddenLayer["activation"] = info.hiddenActivations.value(static_cast<qsizetype>(i));
+        hiddenLayers.append(hiddenLayer);
+    }
+    json["hidden_layers"] = hiddenLayers;
+    json["output_activation"] = info.outputActivation;
+    json["data_precision"] = info.dataPrecision;
+    json["checksum"] = info.checksum;
+    json["parameters"] = info.parameterCount;
+    json["file_size"] = info.fileSize;
+    return json;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-inspect");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("List the architecture and size of model files without loading their weights.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "Model files, or directories to scan for .senm and JSON model files.", "paths...");
+
+    QCommandLineOption jsonOption(QStringList() << "j" << "json", "Print one JSON object per model instead of a table.");
+    parser.addOption(jsonOption);
+    QCommandLineOption verifyOption(QStringList() << "verify",
+                                    "Also load each model and check its weights against the stored checksums.");
+    parser.addOption(verifyOption);
+    parser.process(app);
+
+    const QStringList paths = parser.positionalArguments();
+    if (paths.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    // Collect the files to inspect; JSON files found in directories are
+    // only listed if they are models
+    QStringList files;
+    for (const QString& path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, QStringList() << "*.senm" << "*.json", QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                const QString filePath = it.next();
+                if (filePath.endsWith(".senm", Qt::CaseInsensitive) || isModelJson(filePath)) {
+                    files.append(filePath);
+                }
+            }
+        } else {
+            files.append(path);
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    QTextStream out(stdout);
+    if (!parser.isSet(jsonOption)) {
+        out << QString("%1  %2  %3  %4  %5  %6\n")
+                   .arg(QString("FORMAT"), -10).arg(QString("LAYERS"), -24).arg(QString("ACTIVATIONS"), -20)
+                   .arg(QString("PARAMETERS"), 12).arg(QString("SIZE (MB)"), 10).arg(QString("PATH"));
+    }
+
+    int failed = 0;
+    qint64 totalParameters = 0;
+    qint64 totalBytes = 0;
+    for (const QString& filePath : files) {
+        MLP::ModelInfo info;
+        if (!MLP::inspectFile(filePath, info)) {
+            qWarning() << "Not a readable model file:" << filePath;
+            ++failed;
+            continue;
+        }
+
+        // Loading verifies the checksums, if the file has any
+        if (parser.isSet(verifyOption) && !MLP::fromFile(filePath)) {
+            qWarning() << "Failed verification:" << filePath;
+            ++failed;
+            continue;
+        }
+
+        totalParameters += info.parameterCount;
+        totalBytes += info.fileSize;
+
+        if (parser.isSet(jsonOption)) {
+            out << QJsonDocument(toJson(filePath, info)).toJson(QJsonDocument::Compact) << '\n';
+            continue;
+        }
+
+        QStringList activations = info.hiddenActivations;
+        activations << info.outputActivation;
+        out << QString("%1  %2  %3  %4  %5  %6\n")
+                   .arg(formatName(info), -10)
+                   .arg(layerSizes(info), -24)
+                   .arg(activations.join(","), -20)
+                   .arg(info.parameterCount, 12)
+                   .arg(info.fileSize / (1024.0 * 1024.0), 10, 'f', 1)
+                   .arg(filePath);
+    }
+
+    if (!parser.isSet(jsonOption)) {
+        out << QString("%1 models, %2 parameters, %3 MB\n")
+                   .arg(files.size() - failed).arg(totalParameters).arg(totalBytes / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+    out.flush();
+
+    return failed == 0 ? 0 : 1;
+}
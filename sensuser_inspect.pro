@@ -0,0 +1,23 @@
+QT += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += /usr/local/include/Eigen
+
+SOURCES += \
+    sensuser_inspect.cpp \
+    mlp.cpp \
+    layer.cpp \
+    philox.cpp \
+    crc32c.cpp \
+    jsonstream.cpp
+
+HEADERS += \
+    mlp.h \
+    layer.h \
+    philox.h \
+    crc32c.h \
+    jsonstream.h
+
+TARGET = sensuser-inspect
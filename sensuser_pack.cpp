@@ -0,0 +1,56 @@
+#include "datasetstore.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDebug>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-pack");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Pack positive and negative example images into a .senp dataset file.");
+    parser.addHelpOption();
+
+    QCommandLineOption positiveOption(QStringList() << "p" << "positive", "Directory with positive examples.", "dir");
+    QCommandLineOption negativeOption(QStringList() << "n" << "negative", "Directory with negative examples.", "dir");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Pack file to write.", "file");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Side length of the stored samples in pixels.", "pixels", "512");
+    parser.addOption(positiveOption);
+    parser.addOption(negativeOption);
+    parser.addOption(outputOption);
+    parser.addOption(sizeOption);
+    parser.process(app);
+
+    if (!parser.isSet(positiveOption) || !parser.isSet(outputOption)) {
+        qCritical() << "Both --positive and --output are required.";
+        parser.showHelp(1);
+    }
+
+    bool ok = false;
+    int side = parser.value(sizeOption).toInt(&ok);
+    if (!ok || side <= 0) {
+        qCritical() << "Invalid sample size:" << parser.value(sizeOption);
+        return 1;
+    }
+
+    QStringList positiveFiles = DatasetStore::imageFiles(parser.value(positiveOption));
+    QStringList negativeFiles;
+    if (parser.isSet(negativeOption)) {
+        negativeFiles = DatasetStore::imageFiles(parser.value(negativeOption));
+    }
+    qDebug() << "Found" << positiveFiles.size() << "positive and" << negativeFiles.size() << "negative images";
+
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 written = DatasetStore::writePack(parser.value(outputOption), positiveFiles, negativeFiles, side, side);
+    if (written < 0) {
+        qCritical() << "Failed to write" << parser.value(outputOption);
+        return 1;
+    }
+
+    qDebug() << "Packed" << written << "samples into" << parser.value(outputOption) << "in" << timer.elapsed() << "ms";
+    return 0;
+}
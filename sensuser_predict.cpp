@@ -0,0 +1,407 @@
+#include "mlp.h"
+#include "datasetstore.h"
+#include "streamingpredictor.h"
+#include "cascade.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Images scored between writes of the results, which keep the input order
+const int BATCH_FILES = 1024;
+
+// Side length of the network input
+const int INPUT_SIDE = 512;
+
+// Outcome of scoring one image
+struct Result
+{
+    float score = 0.0f;
+    QString error;              // empty on success
+    qint64 latencyNs = 0;       // decode, preprocess and score of its batch
+};
+
+// Paths listed one per line in a file, or on standard input for "-"
+bool readFileList(const QString& listPath, QStringList& files)
+{
+    QFile file(listPath);
+    const bool opened = listPath == "-" ? file.open(stdin, QIODevice::ReadOnly | QIODevice::Text)
+                                        : file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!opened) {
+        return false;
+    }
+
+    QTextStream in(&file);
+    QString line;
+    while (in.readLineInto(&line)) {
+        line = line.trimmed();
+        if (!line.isEmpty()) {
+            files.append(line);
+        }
+    }
+    return true;
+}
+
+// Quote a CSV field if it needs it
+QString csvField(const QString& value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n')) {
+        return value;
+    }
+    QString quoted = value;
+    quoted.replace("\"", "\"\"");
+    return "\"" + quoted + "\"";
+}
+
+// Latency at a fraction of the sorted samples, in milliseconds
+double percentileMs(const std::vector<qint64>& sorted, double fraction)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+    return sorted[index] / 1000000.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-predict");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Score images with a trained model, without a display.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "Images, or directories to scan for images.", "[paths...]");
+
+    QCommandLineOption modelOption(QStringList() << "m" << "model", "Model file (.senm or JSON).", "file");
+    QCommandLineOption cascadeOption(QStringList() << "cascade",
+                                     "Cascade file written by sensuser-cascade. Its screening model scores every image "
+                                     "and its full model, or --model if set, only the uncertain ones.", "file");
+    QCommandLineOption listOption(QStringList() << "l" << "list", "File listing one image per line, - for standard input.", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "File to write the scores to, standard output if not set.", "file");
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+                                    "Output format, csv or jsonl. Taken from the output file extension if not set.", "format");
+    QCommandLineOption thresholdOption(QStringList() << "t" << "threshold", "Score at or above which an image is positive.",
+                                       "score", "0.5");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of scoring threads, 0 for one per core.",
+                                     "count", "0");
+    QCommandLineOption batchSizeOption(QStringList() << "b" << "batch-size",
+                                       "Images scored together by one thread, with one matrix product per layer.",
+                                       "count", "32");
+    QCommandLineOption streamOption(QStringList() << "stream",
+                                    "Treat the images as consecutive frames of one camera and update the first "
+                                    "layer only for the pixels that changed. Scores on one thread.");
+    QCommandLineOption changeThresholdOption(QStringList() << "change-threshold",
+                                             "With --stream, smallest change in gray levels that is applied.",
+                                             "levels", "2");
+    QCommandLineOption maxChangedOption(QStringList() << "max-changed",
+                                        "With --stream, share of changed pixels above which a frame is "
+                                        "recomputed in full.", "fraction", "0.1");
+    parser.addOption(modelOption);
+    parser.addOption(cascadeOption);
+    parser.addOption(listOption);
+    parser.addOption(outputOption);
+    parser.addOption(formatOption);
+    parser.addOption(thresholdOption);
+    parser.addOption(threadsOption);
+    parser.addOption(batchSizeOption);
+    parser.addOption(streamOption);
+    parser.addOption(changeThresholdOption);
+    parser.addOption(maxChangedOption);
+    parser.process(app);
+
+    if (!parser.isSet(modelOption) && !parser.isSet(cascadeOption)) {
+        qCritical() << "--model or --cascade is required.";
+        parser.showHelp(1);
+    }
+    if (parser.isSet(cascadeOption) && parser.isSet(streamOption)) {
+        qCritical() << "--cascade and --stream cannot be combined.";
+        return 1;
+    }
+
+    bool ok = false;
+    const float threshold = parser.value(thresholdOption).toFloat(&ok);
+    if (!ok) {
+        qCritical() << "Invalid threshold:" << parser.value(thresholdOption);
+        return 1;
+    }
+    int threads = parser.value(threadsOption).toInt(&ok);
+    if (!ok || threads < 0) {
+        qCritical() << "Invalid thread count:" << parser.value(threadsOption);
+        return 1;
+    }
+    if (threads == 0) {
+        threads = qMax(1, QThread::idealThreadCount());
+    }
+    const int batchSize = parser.value(batchSizeOption).toInt(&ok);
+    if (!ok || batchSize <= 0 || batchSize > BATCH_FILES) {
+        qCritical() << "Invalid batch size:" << parser.value(batchSizeOption);
+        return 1;
+    }
+
+    StreamingOptions streaming;
+    streaming.changeThreshold = parser.value(changeThresholdOption).toFloat(&ok) / 255.0f;
+    if (!ok || streaming.changeThreshold < 0.0f) {
+        qCritical() << "Invalid change threshold:" << parser.value(changeThresholdOption);
+        return 1;
+    }
+    streaming.maxChangedFraction = parser.value(maxChangedOption).toFloat(&ok);
+    if (!ok || streaming.maxChangedFraction < 0.0f || streaming.maxChangedFraction > 1.0f) {
+        qCritical() << "Invalid changed pixel share:" << parser.value(maxChangedOption);
+        return 1;
+    }
+
+    QString format = parser.value(formatOption).toLower();
+    if (format.isEmpty()) {
+        format = parser.value(outputOption).endsWith(".jsonl", Qt::CaseInsensitive) ? "jsonl" : "csv";
+    }
+    if (format != "csv" && format != "jsonl") {
+        qCritical() << "Unknown output format:" << format;
+        return 1;
+    }
+
+    // Collect the images to score
+    QStringList files;
+    for (const QString& path : parser.positionalArguments()) {
+        if (QFileInfo(path).isDir()) {
+            files.append(DatasetStore::imageFiles(path));
+        } else {
+            files.append(path);
+        }
+    }
+    if (parser.isSet(listOption) && !readFileList(parser.value(listOption), files)) {
+        qCritical() << "Failed to read file list" << parser.value(listOption);
+        return 1;
+    }
+    if (files.isEmpty()) {
+        qCritical() << "No images to score.";
+        return 1;
+    }
+
+    CascadeFile cascadeFile;
+    if (parser.isSet(cascadeOption) && !cascadeFile.read(parser.value(cascadeOption))) {
+        qCritical() << "Failed to read cascade" << parser.value(cascadeOption);
+        return 1;
+    }
+    const QString modelPath = parser.isSet(modelOption) ? parser.value(modelOption) : cascadeFile.fullPath;
+
+    // All threads share one copy of the weights; version 3 files are mapped
+    QElapsedTimer timer;
+    timer.start();
+    std::unique_ptr<const MLP> model = MLP::fromFile(modelPath, true);
+    if (!model) {
+        qCritical() << "Failed to load model" << modelPath;
+        return 1;
+    }
+    if (model->getLayers().front().getInputSize() != INPUT_SIDE * INPUT_SIDE) {
+        qCritical() << "The model does not take" << INPUT_SIDE << "x" << INPUT_SIDE << "images";
+        return 1;
+    }
+
+    std::unique_ptr<const MLP> screenModel;
+    std::unique_ptr<Cascade> cascade;
+    if (parser.isSet(cascadeOption)) {
+        screenModel = MLP::fromFile(cascadeFile.screenPath, true);
+        if (!screenModel) {
+            qCritical() << "Failed to load screening model" << cascadeFile.screenPath;
+            return 1;
+        }
+        cascade = std::make_unique<Cascade>(*screenModel, *model, cascadeFile.thresholds);
+        if (!cascade->isValid()) {
+            qCritical() << "The screening model does not take smaller square images than the full model";
+            return 1;
+        }
+    }
+    qDebug() << "Loaded model in" << timer.elapsed() << "ms";
+
+    QFile outputFile;
+    if (parser.isSet(outputOption)) {
+        outputFile.setFileName(parser.value(outputOption));
+        ok = outputFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    } else {
+        ok = outputFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    if (!ok) {
+        qCritical() << "Failed to open output" << parser.value(outputOption);
+        return 1;
+    }
+    QTextStream out(&outputFile);
+    if (format == "csv") {
+        out << "path,score,label\n";
+    }
+
+    // Decode, preprocess and score on the pool, a batch at a time
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    std::vector<qint64> latencies;
+    latencies.reserve(static_cast<size_t>(files.size()));
+    int failed = 0;
+    int fullFrames = 0;
+    QAtomicInt escalated = 0;
+    std::unique_ptr<StreamingPredictor> stream;
+    if (parser.isSet(streamOption)) {
+        stream = std::make_unique<StreamingPredictor>(*model, streaming);
+    }
+    timer.restart();
+
+    for (qsizetype start = 0; start < files.size(); start += BATCH_FILES) {
+        const qsizetype end = std::min(files.size(), start + BATCH_FILES);
+        std::vector<Result> results(static_cast<size_t>(end - start));
+
+        // Frames depend on the one before, so they are scored in order
+        for (qsizetype i = start; stream && i < end; ++i) {
+            Result& result = results[static_cast<size_t>(i - start)];
+            QElapsedTimer latency;
+            latency.start();
+            QImageReader reader(files.at(i));
+            const QImage image = reader.read();
+            if (image.isNull()) {
+                result.error = reader.errorString();
+                continue;
+            }
+            result.score = stream->predict(image);
+            result.latencyNs = latency.nsecsElapsed();
+            fullFrames += stream->wasLastFull() ? 1 : 0;
+        }
+
+        // Each task decodes and scores a batch of its own, so the threads
+        // multiply independent batches
+        for (qsizetype first = start; !stream && first < end; first += batchSize) {
+            const qsizetype last = std::min(end, first + batchSize);
+            pool.start([&files, &results, &model, &cascade, &escalated, first, last, start]() {
+                // Scratch space of the pool thread, reused across batches
+                thread_local MLP::InferenceContext context;
+                thread_local Cascade::Context cascadeContext;
+                thread_local Eigen::MatrixXf batch;
+
+                QElapsedTimer latency;
+                latency.start();
+
+                // The cascade resamples the decoded images itself
+                if (cascade) {
+                    QList<QImage> images;
+                    std::vector<qsizetype> decoded;
+                    for (qsizetype i = first; i < last; ++i) {
+                        QImageReader reader(files.at(i));
+                        QImage image = reader.read();
+                        if (image.isNull()) {
+                            results[static_cast<size_t>(i - start)].error = reader.errorString();
+                            continue;
+                        }
+                        images.append(image);
+                        decoded.push_back(i);
+                    }
+                    if (decoded.empty()) {
+                        return;
+                    }
+
+                    const Eigen::VectorXf scores = cascade->predictBatch(images, cascadeContext);
+                    escalated.fetchAndAddRelaxed(static_cast<int>(cascadeContext.escalated.size()));
+                    const qint64 latencyNs = latency.nsecsElapsed();
+                    for (size_t j = 0; j < decoded.size(); ++j) {
+                        Result& result = results[static_cast<size_t>(decoded[j] - start)];
+                        result.score = scores(static_cast<Eigen::Index>(j));
+                        result.latencyNs = latencyNs;
+                    }
+                    return;
+                }
+
+                // Decoded images fill the leading columns in order
+                std::vector<qsizetype> decoded;
+                batch.resize(INPUT_SIDE * INPUT_SIDE, last - first);
+                for (qsizetype i = first; i < last; ++i) {
+                    QImageReader reader(files.at(i));
+                    QImage image = reader.read();
+                    if (image.isNull()) {
+                        results[static_cast<size_t>(i - start)].error = reader.errorString();
+                        continue;
+                    }
+                    MLP::preprocessImage(image, batch.col(static_cast<Eigen::Index>(decoded.size())));
+                    decoded.push_back(i);
+                }
+                if (decoded.empty()) {
+                    return;
+                }
+
+                const Eigen::VectorXf scores =
+                    model->predictBatch(batch.leftCols(static_cast<Eigen::Index>(decoded.size())), context);
+                const qint64 latencyNs = latency.nsecsElapsed();
+                for (size_t j = 0; j < decoded.size(); ++j) {
+                    Result& result = results[static_cast<size_t>(decoded[j] - start)];
+                    result.score = scores(static_cast<Eigen::Index>(j));
+                    result.latencyNs = latencyNs;
+                }
+            });
+        }
+        pool.waitForDone();
+
+        for (qsizetype i = start; i < end; ++i) {
+            const Result& result = results[static_cast<size_t>(i - start)];
+            const QString& filePath = files.at(i);
+
+            if (!result.error.isEmpty()) {
+                qWarning() << "Failed to load image:" << filePath << result.error;
+                ++failed;
+            } else {
+                latencies.push_back(result.latencyNs);
+            }
+
+            if (format == "csv") {
+                if (result.error.isEmpty()) {
+                    out << csvField(filePath) << ',' << QString::number(result.score, 'g', 6) << ','
+                        << (result.score >= threshold ? 1 : 0) << '\n';
+                } else {
+                    out << csvField(filePath) << ",,error\n";
+                }
+            } else {
+                QJsonObject json;
+                json["path"] = filePath;
+                if (result.error.isEmpty()) {
+                    json["score"] = result.score;
+                    json["positive"] = result.score >= threshold;
+                } else {
+                    json["error"] = result.error;
+                }
+                out << QJsonDocument(json).toJson(QJsonDocument::Compact) << '\n';
+            }
+        }
+        out.flush();
+    }
+
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    std::sort(latencies.begin(), latencies.end());
+
+    qDebug().noquote() << QString("Scored %1 images (%2 failed) in %3 s, %4 images/s")
+                              .arg(latencies.size()).arg(failed).arg(seconds, 0, 'f', 2)
+                              .arg(latencies.size() / qMax(seconds, 1e-9), 0, 'f', 1);
+    qDebug().noquote() << QString("Latency ms: p50 %1, p90 %2, p99 %3, max %4")
+                              .arg(percentileMs(latencies, 0.50), 0, 'f', 2)
+                              .arg(percentileMs(latencies, 0.90), 0, 'f', 2)
+                              .arg(percentileMs(latencies, 0.99), 0, 'f', 2)
+                              .arg(latencies.empty() ? 0.0 : latencies.back() / 1000000.0, 0, 'f', 2);
+    if (stream) {
+        qDebug().noquote() << QString("%1 of %2 frames computed in full").arg(fullFrames).arg(latencies.size());
+    }
+    if (cascade) {
+        qDebug().noquote() << QString("%1 of %2 images passed to the full model").arg(escalated.loadRelaxed())
+                                  .arg(latencies.size());
+    }
+
+    return failed == 0 ? 0 : 1;
+}
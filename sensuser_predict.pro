@@ -0,0 +1,29 @@
+QT += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += /usr/local/include/Eigen
+
+SOURCES += \
+    sensuser_predict.cpp \
+    datasetstore.cpp \
+    mlp.cpp \
+    cascade.cpp \
+    streamingpredictor.cpp \
+    layer.cpp \
+    philox.cpp \
+    crc32c.cpp \
+    jsonstream.cpp
+
+HEADERS += \
+    datasetstore.h \
+    mlp.h \
+    cascade.h \
+    streamingpredictor.h \
+    layer.h \
+    philox.h \
+    crc32c.h \
+    jsonstream.h
+
+TARGET = sensuser-predict
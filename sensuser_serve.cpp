@@ -0,0 +1,252 @@
+#include "mlp.h"
+#include "inferenceserver.h"
+#include "datasetstore.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Side length of the network input
+const int INPUT_SIDE = 512;
+
+// Longest wait for the server before the client gives up
+const int CLIENT_TIMEOUT_MS = 30000;
+
+// Latency at a fraction of the sorted samples, in milliseconds
+double percentileMs(const std::vector<qint64>& sorted, double fraction)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+    return sorted[index] / 1000000.0;
+}
+
+/**
+ * @brief Score images through a running server and report the latency it adds
+ *
+ * Keeps up to concurrency requests in flight on one connection, so the
+ * server has something to batch, and prints one line per response.
+ */
+int runClient(QIODevice& connection, const QStringList& files, int concurrency)
+{
+    QTextStream out(stdout);
+    std::vector<qint64> sentNs(static_cast<size_t>(files.size()));
+    std::vector<qint64> latencies;
+    latencies.reserve(static_cast<size_t>(files.size()));
+    qint64 batchTotal = 0;
+    int failed = 0;
+
+    QElapsedTimer clock;
+    clock.start();
+    qsizetype sent = 0;
+    qsizetype received = 0;
+
+    while (received < files.size()) {
+        while (sent < files.size() && sent - received < concurrency) {
+            QJsonObject request;
+            request["id"] = static_cast<qint64>(sent);
+            request["path"] = QFileInfo(files.at(sent)).absoluteFilePath();
+            sentNs[static_cast<size_t>(sent)] = clock.nsecsElapsed();
+            connection.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+            ++sent;
+        }
+
+        if (!connection.canReadLine() && !connection.waitForReadyRead(CLIENT_TIMEOUT_MS)) {
+            qCritical() << "No response from the server:" << connection.errorString();
+            return 1;
+        }
+
+        while (connection.canReadLine()) {
+            const QJsonObject response = QJsonDocument::fromJson(connection.readLine()).object();
+            const qint64 id = response["id"].toInteger(-1);
+            if (id < 0 || id >= sent) {
+                qWarning() << "Unexpected response from the server";
+                continue;
+            }
+            ++received;
+
+            const QString& filePath = files.at(id);
+            if (response.contains("error")) {
+                qWarning() << "Failed to score" << filePath << response["error"].toString();
+                ++failed;
+                continue;
+            }
+            latencies.push_back(clock.nsecsElapsed() - sentNs[static_cast<size_t>(id)]);
+            batchTotal += response["batch"].toInt();
+            out << filePath << ',' << QString::number(response["score"].toDouble(), 'g', 6) << '\n';
+        }
+    }
+    out.flush();
+
+    const double seconds = clock.nsecsElapsed() / 1e9;
+    std::sort(latencies.begin(), latencies.end());
+
+    qDebug().noquote() << QString("Scored %1 images (%2 failed) in %3 s, %4 images/s, mean batch %5")
+                              .arg(latencies.size()).arg(failed).arg(seconds, 0, 'f', 2)
+                              .arg(latencies.size() / qMax(seconds, 1e-9), 0, 'f', 1)
+                              .arg(latencies.empty() ? 0.0 : static_cast<double>(batchTotal) / latencies.size(), 0, 'f', 1);
+    qDebug().noquote() << QString("Round trip ms: p50 %1, p90 %2, p99 %3, max %4")
+                              .arg(percentileMs(latencies, 0.50), 0, 'f', 2)
+                              .arg(percentileMs(latencies, 0.90), 0, 'f', 2)
+                              .arg(percentileMs(latencies, 0.99), 0, 'f', 2)
+                              .arg(latencies.empty() ? 0.0 : latencies.back() / 1000000.0, 0, 'f', 2);
+
+    return failed == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-serve");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Keep a model loaded and score images for local clients, batching "
+                                     "concurrent requests. With --client, send images to a running server.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "With --client, images or directories of images to score.", "[paths...]");
+
+    QCommandLineOption modelOption(QStringList() << "m" << "model", "Model file (.senm or JSON).", "file");
+    QCommandLineOption socketOption(QStringList() << "s" << "socket", "Local socket name or path.", "name");
+    QCommandLineOption portOption(QStringList() << "p" << "port", "TCP port on the loopback interface.", "port");
+    QCommandLineOption maxBatchOption(QStringList() << "max-batch", "Most requests scored together.", "count", "32");
+    QCommandLineOption maxDelayOption(QStringList() << "max-delay",
+                                      "Longest a request waits for others to join its batch.", "ms", "2");
+    QCommandLineOption workersOption(QStringList() << "workers", "Threads scoring batches.", "count", "2");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+                                     "Threads decoding images, 0 for one per core.", "count", "0");
+    QCommandLineOption maxQueueOption(QStringList() << "max-queue",
+                                      "Most requests waiting to be scored; more are refused.", "count", "1024");
+    QCommandLineOption clientOption(QStringList() << "client", "Send the given images to a running server.");
+    QCommandLineOption concurrencyOption(QStringList() << "c" << "concurrency",
+                                         "With --client, requests kept in flight.", "count", "32");
+    parser.addOption(modelOption);
+    parser.addOption(socketOption);
+    parser.addOption(portOption);
+    parser.addOption(maxBatchOption);
+    parser.addOption(maxDelayOption);
+    parser.addOption(workersOption);
+    parser.addOption(threadsOption);
+    parser.addOption(maxQueueOption);
+    parser.addOption(clientOption);
+    parser.addOption(concurrencyOption);
+    parser.process(app);
+
+    if (!parser.isSet(socketOption) && !parser.isSet(portOption)) {
+        qCritical() << "--socket or --port is required.";
+        parser.showHelp(1);
+    }
+
+    bool ok = true;
+    const quint16 port = parser.isSet(portOption) ? parser.value(portOption).toUShort(&ok) : 0;
+    if (!ok || (parser.isSet(portOption) && port == 0)) {
+        qCritical() << "Invalid port:" << parser.value(portOption);
+        return 1;
+    }
+
+    if (parser.isSet(clientOption)) {
+        const int concurrency = parser.value(concurrencyOption).toInt(&ok);
+        if (!ok || concurrency <= 0) {
+            qCritical() << "Invalid concurrency:" << parser.value(concurrencyOption);
+            return 1;
+        }
+
+        QStringList files;
+        for (const QString& path : parser.positionalArguments()) {
+            if (QFileInfo(path).isDir()) {
+                files.append(DatasetStore::imageFiles(path));
+            } else {
+                files.append(path);
+            }
+        }
+        if (files.isEmpty()) {
+            qCritical() << "No images to score.";
+            return 1;
+        }
+
+        if (parser.isSet(socketOption)) {
+            QLocalSocket socket;
+            socket.connectToServer(parser.value(socketOption));
+            if (!socket.waitForConnected(CLIENT_TIMEOUT_MS)) {
+                qCritical() << "Failed to connect to" << parser.value(socketOption) << socket.errorString();
+                return 1;
+            }
+            return runClient(socket, files, concurrency);
+        }
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        if (!socket.waitForConnected(CLIENT_TIMEOUT_MS)) {
+            qCritical() << "Failed to connect to port" << port << socket.errorString();
+            return 1;
+        }
+        return runClient(socket, files, concurrency);
+    }
+
+    if (!parser.isSet(modelOption)) {
+        qCritical() << "--model is required.";
+        parser.showHelp(1);
+    }
+
+    ServeOptions options;
+    bool valid[5];
+    options.maxBatchSize = parser.value(maxBatchOption).toInt(&valid[0]);
+    options.maxDelayMs = parser.value(maxDelayOption).toInt(&valid[1]);
+    options.batchThreads = parser.value(workersOption).toInt(&valid[2]);
+    options.decodeThreads = parser.value(threadsOption).toInt(&valid[3]);
+    options.maxQueued = parser.value(maxQueueOption).toInt(&valid[4]);
+    for (bool value : valid) {
+        if (!value) {
+            qCritical() << "Numeric options must be numbers.";
+            return 1;
+        }
+    }
+    if (options.maxBatchSize <= 0 || options.maxDelayMs < 0 || options.batchThreads <= 0 || options.decodeThreads < 0 ||
+        options.maxQueued <= 0) {
+        qCritical() << "Option out of range.";
+        return 1;
+    }
+
+    // Loaded once and shared by every batch thread; version 3 files are mapped
+    QElapsedTimer timer;
+    timer.start();
+    std::shared_ptr<const MLP> model = MLP::fromFile(parser.value(modelOption), true);
+    if (!model) {
+        qCritical() << "Failed to load model" << parser.value(modelOption);
+        return 1;
+    }
+    if (model->getLayers().front().getInputSize() != INPUT_SIDE * INPUT_SIDE) {
+        qCritical() << "The model does not take" << INPUT_SIDE << "x" << INPUT_SIDE << "images";
+        return 1;
+    }
+    qDebug() << "Loaded model in" << timer.elapsed() << "ms";
+
+    InferenceServer server(model, options);
+    if (parser.isSet(socketOption)) {
+        if (!server.listenLocal(parser.value(socketOption))) {
+            return 1;
+        }
+        qDebug() << "Listening on" << parser.value(socketOption);
+    }
+    if (parser.isSet(portOption)) {
+        if (!server.listenTcp(port)) {
+            return 1;
+        }
+        qDebug() << "Listening on port" << port;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,27 @@
+QT += core gui network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += /usr/local/include/Eigen
+
+SOURCES += \
+    sensuser_serve.cpp \
+    inferenceserver.cpp \
+    datasetstore.cpp \
+    mlp.cpp \
+    layer.cpp \
+    philox.cpp \
+    crc32c.cpp \
+    jsonstream.cpp
+
+HEADERS += \
+    datasetstore.h \
+    inferenceserver.h \
+    mlp.h \
+    layer.h \
+    philox.h \
+    crc32c.h \
+    jsonstream.h
+
+TARGET = sensuser-serve
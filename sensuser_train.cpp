@@ -0,0 +1,196 @@
+#include "mlp.h"
+#include "trainingworker.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QDebug>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Hidden layer sizes from a comma-separated list such as "128,64"
+bool parseHiddenSizes(const QString& text, std::vector<int>& sizes)
+{
+    sizes.clear();
+    for (const QString& part : text.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int size = part.trimmed().toInt(&ok);
+        if (!ok || size <= 0) {
+            return false;
+        }
+        sizes.push_back(size);
+    }
+    return !sizes.empty();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sensuser-train");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Train a model from example images, without a display.");
+    parser.addHelpOption();
+
+    QCommandLineOption positiveOption(QStringList() << "p" << "positive", "Directory with positive examples.", "dir");
+    QCommandLineOption negativeOption(QStringList() << "n" << "negative", "Directory with negative examples.", "dir");
+    QCommandLineOption packOption(QStringList() << "pack", "Packed dataset to train on instead of the directories.", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Model file to write when training ends.", "file");
+    QCommandLineOption hiddenOption(QStringList() << "hidden", "Hidden layer sizes, comma separated.", "sizes", "128");
+    QCommandLineOption activationOption(QStringList() << "activation", "Hidden activation: sigmoid, relu or tanh.",
+                                        "name", "sigmoid");
+    QCommandLineOption learningRateOption(QStringList() << "r" << "learning-rate", "Learning rate.", "rate", "0.01");
+    QCommandLineOption epochsOption(QStringList() << "e" << "epochs", "Number of epochs.", "count", "100");
+    QCommandLineOption batchSizeOption(QStringList() << "b" << "batch-size", "Batch size.", "size", "10");
+    QCommandLineOption noShuffleOption(QStringList() << "no-shuffle", "Visit the samples in the same order every epoch.");
+    QCommandLineOption seedOption(QStringList() << "seed",
+                                  "Seed of the weight initialization and shuffle, 0 for a random one.", "seed", "0");
+    QCommandLineOption augmentOption(QStringList() << "augment", "Randomly flip, rotate and shift the images each epoch.");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads",
+                                     "Threads used to decode and augment images, 0 for one per core.", "count", "0");
+    QCommandLineOption checkpointOption(QStringList() << "checkpoint", "Checkpoint file to keep up to date.", "file");
+    QCommandLineOption checkpointEpochsOption(QStringList() << "checkpoint-epochs",
+                                              "Save a checkpoint after every this many epochs.", "count", "1");
+    QCommandLineOption checkpointMinutesOption(QStringList() << "checkpoint-minutes",
+                                               "Also save a checkpoint when this many minutes have passed.", "minutes", "0");
+    QCommandLineOption resumeOption(QStringList() << "resume",
+                                    "Continue the run saved in a checkpoint; its settings replace the ones above.", "file");
+    QCommandLineOption formatOption(QStringList() << "format", "Format version of the output model, 2 or 3.",
+                                    "version", "2");
+    QCommandLineOption compressOption(QStringList() << "compress",
+                                      "zlib level to compress a version 3 output model with, 0 for none.", "level", "0");
+    parser.addOption(positiveOption);
+    parser.addOption(negativeOption);
+    parser.addOption(packOption);
+    parser.addOption(outputOption);
+    parser.addOption(hiddenOption);
+    parser.addOption(activationOption);
+    parser.addOption(learningRateOption);
+    parser.addOption(epochsOption);
+    parser.addOption(batchSizeOption);
+    parser.addOption(noShuffleOption);
+    parser.addOption(seedOption);
+    parser.addOption(augmentOption);
+    parser.addOption(threadsOption);
+    parser.addOption(checkpointOption);
+    parser.addOption(checkpointEpochsOption);
+    parser.addOption(checkpointMinutesOption);
+    parser.addOption(resumeOption);
+    parser.addOption(formatOption);
+    parser.addOption(compressOption);
+    parser.process(app);
+
+    if ((!parser.isSet(positiveOption) && !parser.isSet(packOption)) || !parser.isSet(outputOption)) {
+        qCritical() << "--output and either --positive or --pack are required.";
+        parser.showHelp(1);
+    }
+
+    // Validate the numeric options up front, so a long job does not fail at the end
+    std::vector<int> hiddenSizes;
+    if (!parseHiddenSizes(parser.value(hiddenOption), hiddenSizes)) {
+        qCritical() << "Invalid hidden layer sizes:" << parser.value(hiddenOption);
+        return 1;
+    }
+    const QString activation = parser.value(activationOption);
+    if (activation != "sigmoid" && activation != "relu" && activation != "tanh") {
+        qCritical() << "Unknown activation:" << activation;
+        return 1;
+    }
+
+    bool ok[9];
+    const float learningRate = parser.value(learningRateOption).toFloat(&ok[0]);
+    const int epochs = parser.value(epochsOption).toInt(&ok[1]);
+    const int batchSize = parser.value(batchSizeOption).toInt(&ok[2]);
+    const quint64 seed = parser.value(seedOption).toULongLong(&ok[3]);
+    const int threads = parser.value(threadsOption).toInt(&ok[4]);
+    const int checkpointEpochs = parser.value(checkpointEpochsOption).toInt(&ok[5]);
+    const int checkpointMinutes = parser.value(checkpointMinutesOption).toInt(&ok[6]);
+    const int formatVersion = parser.value(formatOption).toInt(&ok[7]);
+    const int compressionLevel = parser.value(compressOption).toInt(&ok[8]);
+    for (bool valid : ok) {
+        if (!valid) {
+            qCritical() << "Numeric options must be numbers.";
+            return 1;
+        }
+    }
+    if (learningRate <= 0.0f || epochs <= 0 || batchSize <= 0 || threads < 0 ||
+        checkpointEpochs < 0 || checkpointMinutes < 0 ||
+        (formatVersion != 2 && formatVersion != 3) || compressionLevel < -1 || compressionLevel > 9) {
+        qCritical() << "Option out of range.";
+        return 1;
+    }
+
+    MLP::BinaryOptions outputOptions;
+    outputOptions.formatVersion = static_cast<quint8>(formatVersion);
+    outputOptions.compressionLevel = compressionLevel;
+
+    // The network takes 512x512 grayscale images, as in the GUI
+    MLP mlp(512 * 512, hiddenSizes, 1, activation.toStdString(), "sigmoid", seed);
+
+    TrainingWorker worker(&mlp);
+    worker.setPositiveDir(parser.value(positiveOption));
+    worker.setNegativeDir(parser.value(negativeOption));
+    worker.setPackFile(parser.value(packOption));
+    worker.setLearningRate(learningRate);
+    worker.setEpochs(epochs);
+    worker.setBatchSize(batchSize);
+    worker.setShuffle(!parser.isSet(noShuffleOption));
+    worker.setShuffleSeed(seed);
+    worker.setThreadCount(threads);
+
+    AugmentationOptions augmentation;
+    augmentation.enabled = parser.isSet(augmentOption);
+    worker.setAugmentation(augmentation);
+
+    CheckpointOptions checkpoint;
+    if (parser.isSet(checkpointOption)) {
+        checkpoint.filePath = parser.value(checkpointOption);
+        checkpoint.intervalEpochs = checkpointEpochs;
+        checkpoint.intervalMinutes = checkpointMinutes;
+    }
+    worker.setCheckpoint(checkpoint);
+    worker.setResumeFile(parser.value(resumeOption));
+
+    // The worker runs on this thread, so its signals are handled as they are emitted
+    QTextStream out(stdout);
+    QElapsedTimer runTimer;
+    QElapsedTimer epochTimer;
+    bool failed = false;
+
+    QObject::connect(&worker, &TrainingWorker::progressUpdated, [&](int epoch, int totalEpochs, float loss) {
+        out << QString("epoch %1/%2  loss %3  %4 s\n")
+                   .arg(epoch).arg(totalEpochs).arg(loss, 0, 'f', 6).arg(epochTimer.nsecsElapsed() / 1e9, 0, 'f', 2);
+        out.flush();
+        epochTimer.restart();
+    });
+    QObject::connect(&worker, &TrainingWorker::trainingFailed, [&](const QString& reason) {
+        qCritical().noquote() << reason;
+        failed = true;
+    });
+    QObject::connect(&worker, &TrainingWorker::trainingComplete, [&](float finalLoss) {
+        if (!failed) {
+            out << QString("Training complete in %1 s, final loss %2\n")
+                       .arg(runTimer.nsecsElapsed() / 1e9, 0, 'f', 1).arg(finalLoss, 0, 'f', 6);
+            out.flush();
+        }
+    });
+
+    runTimer.start();
+    epochTimer.start();
+    worker.train();
+    if (failed) {
+        return 1;
+    }
+
+    if (!mlp.saveToBinary(parser.value(outputOption), outputOptions)) {
+        qCritical() << "Failed to write" << parser.value(outputOption);
+        return 1;
+    }
+    out << "Model written to " << parser.value(outputOption) << '\n';
+
+    return 0;
+}
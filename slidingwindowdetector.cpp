@@ -0,0 +1,190 @@
+#include "slidingwindowdetector.h"
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+SlidingWindowDetector::SlidingWindowDetector(const MLP& model, const SlidingWindowOptions& options)
+    : model(model), options(options)
+{
+}
+
+std::vector<int> SlidingWindowDetector::windowPositions(int size, int stride)
+{
+    std::vector<int> positions;
+    for (int position = 0; position + INPUT_SIDE <= size; position += stride) {
+        positions.push_back(position);
+    }
+    if (!positions.empty() && positions.back() + INPUT_SIDE < size) {
+        positions.push_back(size - INPUT_SIDE);
+    }
+    return positions;
+}
+
+bool SlidingWindowDetector::detect(const QImage& image, std::vector<WindowScore>& windows) const
+{
+    windows.clear();
+    if (model.getLayers().empty() || model.getLayers().front().getInputSize() != INPUT_SIDE * INPUT_SIDE) {
+        qWarning() << "Sliding windows need a model taking" << INPUT_SIDE << "x" << INPUT_SIDE << "inputs";
+        return false;
+    }
+    if (image.isNull() || options.windowSize <= 0 || options.stride <= 0) {
+        return false;
+    }
+
+    // A level resamples the image so that one window spans the network input
+    struct Level
+    {
+        double scale;
+        double factor;          // level pixels per image pixel
+        int width;
+        int height;
+        Plane plane;
+        std::vector<int> xs;
+        std::vector<int> ys;
+    };
+
+    std::vector<Level> levels;
+    for (double scale : options.scales) {
+        if (scale <= 0.0) {
+            continue;
+        }
+        Level level;
+        level.scale = scale;
+        level.factor = INPUT_SIDE / (options.windowSize * scale);
+        level.width = static_cast<int>(std::lround(image.width() * level.factor));
+        level.height = static_cast<int>(std::lround(image.height() * level.factor));
+        if (level.width < INPUT_SIDE || level.height < INPUT_SIDE) {
+            continue;
+        }
+
+        // The stride scales with the window, so it is the same at every level
+        const int stride = qMax(1, static_cast<int>(std::lround(options.stride * level.factor * scale)));
+        level.xs = windowPositions(level.width, stride);
+        level.ys = windowPositions(level.height, stride);
+        levels.push_back(std::move(level));
+    }
+    if (levels.empty()) {
+        qWarning() << "The image is smaller than the window at every scale";
+        return false;
+    }
+
+    QThreadPool pool;
+    if (options.threadCount > 0) {
+        pool.setMaxThreadCount(options.threadCount);
+    }
+
+    // Convert to grayscale once for all levels, then resample and normalize each level once
+    const QImage gray = image.format() == QImage::Format_Grayscale8
+                            ? image : image.convertToFormat(QImage::Format_Grayscale8);
+    for (Level& level : levels) {
+        pool.start([&gray, &level]() {
+            const QImage resampled = MLP::toInputImage(gray, level.width, level.height);
+            level.plane.resize(level.height, level.width);
+            for (int y = 0; y < level.height; ++y) {
+                const uchar* line = resampled.constScanLine(y);
+                float* row = level.plane.row(y).data();
+                for (int x = 0; x < level.width; ++x) {
+                    row[x] = static_cast<float>(line[x]) / 255.0f;
+                }
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // Lay out every window, remembering its level and position in the level
+    struct Placement
+    {
+        const Level* level;
+        int x;
+        int y;
+    };
+    std::vector<Placement> placements;
+    for (const Level& level : levels) {
+        const int side = static_cast<int>(std::lround(options.windowSize * level.scale));
+        for (int y : level.ys) {
+            for (int x : level.xs) {
+                placements.push_back({&level, x, y});
+
+                WindowScore window;
+                window.rect = QRect(static_cast<int>(std::lround(x / level.factor)),
+                                    static_cast<int>(std::lround(y / level.factor)), side, side);
+                window.scale = level.scale;
+                window.score = 0.0f;
+                windows.push_back(window);
+            }
+        }
+    }
+
+    // Score the windows in batches, one batch per pool task
+    const size_t batchSize = static_cast<size_t>(qMax(1, options.batchSize));
+    for (size_t first = 0; first < placements.size(); first += batchSize) {
+        const size_t last = std::min(placements.size(), first + batchSize);
+        pool.start([this, &placements, &windows, first, last]() {
+            // Scratch space of the pool thread, reused across batches
+            thread_local MLP::InferenceContext context;
+            thread_local Eigen::MatrixXf batch;
+
+            batch.resize(INPUT_SIDE * INPUT_SIDE, static_cast<Eigen::Index>(last - first));
+            for (size_t i = first; i < last; ++i) {
+                const Placement& placement = placements[i];
+                float* column = batch.col(static_cast<Eigen::Index>(i - first)).data();
+                for (int y = 0; y < INPUT_SIDE; ++y) {
+                    const float* row = placement.level->plane.row(placement.y + y).data() + placement.x;
+                    std::copy(row, row + INPUT_SIDE, column + y * INPUT_SIDE);
+                }
+            }
+
+            const Eigen::VectorXf scores = model.predictBatch(batch, context);
+            for (size_t i = first; i < last; ++i) {
+                windows[i].score = scores(static_cast<Eigen::Index>(i - first));
+            }
+        });
+    }
+    pool.waitForDone();
+
+    return true;
+}
+
+Eigen::MatrixXf SlidingWindowDetector::heatmap(const std::vector<WindowScore>& windows, const QSize& imageSize,
+                                               int cellSize)
+{
+    cellSize = qMax(1, cellSize);
+    const int columns = (imageSize.width() + cellSize - 1) / cellSize;
+    const int rows = (imageSize.height() + cellSize - 1) / cellSize;
+    Eigen::MatrixXf map = Eigen::MatrixXf::Zero(rows, columns);
+
+    // Cells whose centre lies in [begin, end) along one axis
+    auto cellRange = [cellSize](int begin, int end, int count, int& first, int& last) {
+        const double half = cellSize / 2.0;
+        first = qMax(0, static_cast<int>(std::ceil((begin - half) / cellSize)));
+        last = qMin(count - 1, static_cast<int>(std::ceil((end - half) / cellSize)) - 1);
+    };
+
+    for (const WindowScore& window : windows) {
+        int firstColumn, lastColumn, firstRow, lastRow;
+        cellRange(window.rect.left(), window.rect.left() + window.rect.width(), columns, firstColumn, lastColumn);
+        cellRange(window.rect.top(), window.rect.top() + window.rect.height(), rows, firstRow, lastRow);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                map(row, column) = std::max(map(row, column), window.score);
+            }
+        }
+    }
+
+    return map;
+}
+
+QImage SlidingWindowDetector::heatmapImage(const Eigen::MatrixXf& heatmap, const QSize& size)
+{
+    QImage cells(static_cast<int>(heatmap.cols()), static_cast<int>(heatmap.rows()), QImage::Format_Grayscale8);
+    for (int y = 0; y < cells.height(); ++y) {
+        uchar* line = cells.scanLine(y);
+        for (int x = 0; x < cells.width(); ++x) {
+            line[x] = static_cast<uchar>(std::lround(std::clamp(heatmap(y, x), 0.0f, 1.0f) * 255.0f));
+        }
+    }
+
+    // Nearest-neighbour keeps the cell edges visible
+    return cells.scaled(size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+}
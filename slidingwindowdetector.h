@@ -0,0 +1,101 @@
+#ifndef SLIDINGWINDOWDETECTOR_H
+#define SLIDINGWINDOWDETECTOR_H
+
+#include "mlp.h"
+#include </usr/local/include/Eigen/Dense>
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <vector>
+
+/**
+ * @brief Where windows are placed by the SlidingWindowDetector
+ */
+struct SlidingWindowOptions
+{
+    int windowSize = 512;               ///< Window side in image pixels at scale 1
+    int stride = 256;                   ///< Step between windows in image pixels at scale 1
+    std::vector<double> scales = {1.0}; ///< Pyramid levels; window and stride are multiplied by each
+    int batchSize = 32;                 ///< Windows scored together by one thread
+    int threadCount = 0;                ///< Threads to use, 0 for one per core
+};
+
+/**
+ * @brief Score of one window
+ */
+struct WindowScore
+{
+    QRect rect;         ///< Window in image pixels
+    double scale;       ///< Pyramid level the window belongs to
+    float score;        ///< Probability that the window contains the target object
+};
+
+/**
+ * @brief The SlidingWindowDetector class scores windows of an image larger than the network input
+ *
+ * MLP::preprocessImage squeezes a whole image into the input, so objects
+ * that are small next to the frame vanish. The detector instead slides a
+ * square window over the image at each level of a scale pyramid and scores
+ * every window.
+ *
+ * Each level is converted to grayscale, resampled so a window covers
+ * exactly the network input, and normalized once into a float plane.
+ * Windows are then copied out of the plane row by row, so pixels shared by
+ * overlapping windows are not converted again. Windows are scored in
+ * batches with MLP::predictBatch, with the batches spread over a thread pool.
+ */
+class SlidingWindowDetector
+{
+public:
+    /**
+     * @brief SlidingWindowDetector constructor
+     * @param model Network taking 512x512 inputs; must outlive the detector
+     * @param options Window placement
+     */
+    SlidingWindowDetector(const MLP& model, const SlidingWindowOptions& options = SlidingWindowOptions());
+
+    /**
+     * @brief Score every window of an image
+     *
+     * Windows are placed every stride pixels, plus one flush with the right
+     * and bottom edges, so the whole image is covered. Levels whose window
+     * is larger than the image are skipped.
+     *
+     * @param image Image of any size
+     * @param windows Scores of all windows, level by level in row-major order
+     * @return True if at least one window fit in the image
+     */
+    bool detect(const QImage& image, std::vector<WindowScore>& windows) const;
+
+    /**
+     * @brief Combine window scores into a heatmap
+     * @param windows Window scores from detect
+     * @param imageSize Size of the scored image
+     * @param cellSize Side of a heatmap cell in image pixels
+     * @return Highest score of the windows covering each cell centre, one row per row of cells
+     */
+    static Eigen::MatrixXf heatmap(const std::vector<WindowScore>& windows, const QSize& imageSize, int cellSize);
+
+    /**
+     * @brief Render a heatmap as an image
+     * @param heatmap Heatmap from heatmap()
+     * @param size Size of the image to render, usually the scored image's
+     * @return Grayscale8 image with 255 for a score of 1
+     */
+    static QImage heatmapImage(const Eigen::MatrixXf& heatmap, const QSize& size);
+
+private:
+    // Window side of the network input
+    static const int INPUT_SIDE = 512;
+
+    // A pyramid level as normalized floats, one row of the image per row
+    using Plane = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    // Positions of the windows along an axis of length size, flush with the far end
+    static std::vector<int> windowPositions(int size, int stride);
+
+    const MLP& model;
+    SlidingWindowOptions options;
+};
+
+#endif // SLIDINGWINDOWDETECTOR_H
@@ -0,0 +1,76 @@
+#include "streamingpredictor.h"
+#include <QDebug>
+#include <cmath>
+
+StreamingPredictor::StreamingPredictor(const MLP& model, const StreamingOptions& options)
+    : model(model), options(options), hasReference(false), framesSinceRefresh(0), lastChangedCount(0), lastFull(false)
+{
+    context.preActivations.resize(model.getLayers().size());
+    context.outputs.resize(model.getLayers().size());
+}
+
+float StreamingPredictor::predict(const QImage& frame)
+{
+    const int side = model.getInputSide();
+    if (side <= 0) {
+        qWarning() << "The model does not take square images";
+        return 0.0f;
+    }
+
+    frameInput.resize(static_cast<Eigen::Index>(side) * side);
+    MLP::preprocessImage(frame, frameInput, side);
+    return predict(frameInput);
+}
+
+float StreamingPredictor::predict(const Eigen::VectorXf& input)
+{
+    const std::vector<Layer>& layers = model.getLayers();
+    const Layer& first = layers.front();
+
+    // Collect the changed pixels, giving up once there are too many to be worth it
+    bool full = !hasReference || (options.refreshInterval > 0 && framesSinceRefresh >= options.refreshInterval);
+    if (!full) {
+        const size_t limit = static_cast<size_t>(options.maxChangedFraction * input.size());
+        changed.clear();
+        for (Eigen::Index j = 0; j < input.size(); ++j) {
+            if (std::fabs(input(j) - reference(j)) > options.changeThreshold) {
+                changed.push_back(j);
+                if (changed.size() > limit) {
+                    full = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (full) {
+        first.infer(input, firstZ, context.outputs[0]);
+        reference = input;
+        hasReference = true;
+        framesSinceRefresh = 0;
+        lastChangedCount = static_cast<int>(input.size());
+    } else {
+        // z += W[:, j] * dx_j over the changed pixels only, gathering their columns in one product
+        changedDelta.resize(static_cast<Eigen::Index>(changed.size()));
+        for (size_t k = 0; k < changed.size(); ++k) {
+            const Eigen::Index j = changed[k];
+            changedDelta(static_cast<Eigen::Index>(k)) = input(j) - reference(j);
+            reference(j) = input(j);
+        }
+        firstZ.noalias() += first.getWeights()(Eigen::all, changed) * changedDelta;
+        first.activate(firstZ, context.outputs[0]);
+        ++framesSinceRefresh;
+        lastChangedCount = static_cast<int>(changed.size());
+    }
+    lastFull = full;
+
+    for (size_t i = 1; i < layers.size(); ++i) {
+        layers[i].infer(context.outputs[i - 1], context.preActivations[i], context.outputs[i]);
+    }
+    return context.outputs.back()(0);
+}
+
+void StreamingPredictor::reset()
+{
+    hasReference = false;
+}
@@ -0,0 +1,104 @@
+#ifndef STREAMINGPREDICTOR_H
+#define STREAMINGPREDICTOR_H
+
+#include "mlp.h"
+#include </usr/local/include/Eigen/Dense>
+#include <QImage>
+#include <vector>
+
+/**
+ * @brief When the StreamingPredictor updates incrementally
+ */
+struct StreamingOptions
+{
+    float changeThreshold = 2.0f / 255.0f;  ///< Smallest change of a normalized pixel that is applied
+    float maxChangedFraction = 0.1f;        ///< Share of changed pixels above which a frame is recomputed in full
+    int refreshInterval = 1000;             ///< Frames between full recomputes that discard rounding drift, 0 for never
+};
+
+/**
+ * @brief The StreamingPredictor class scores a sequence of similar frames
+ *
+ * The first layer holds nearly all of the weights, and a full pass reads
+ * all of them for every frame. When consecutive frames differ in few
+ * pixels, as from a static camera, the predictor instead keeps the first
+ * layer's pre-activations of the previous frame and adds W[:, j] * dx_j for
+ * each pixel j that changed, so a frame costs in proportion to the pixels
+ * that changed. The remaining layers are small and run in full.
+ *
+ * Pixels that changed by no more than the threshold keep the value last
+ * applied, so slow drift is picked up once it exceeds the threshold rather
+ * than being lost. Frames with too many changed pixels, and every
+ * refreshInterval-th frame, are computed in full.
+ *
+ * The first layer's weights are read in place, so a mapped model stays
+ * shared between predictors. A predictor holds per-stream state and must be
+ * used by one thread at a time.
+ */
+class StreamingPredictor
+{
+public:
+    /**
+     * @brief StreamingPredictor constructor
+     * @param model Model to score with; must outlive the predictor and not change while in use
+     * @param options Incremental update options
+     */
+    StreamingPredictor(const MLP& model, const StreamingOptions& options = StreamingOptions());
+
+    /**
+     * @brief Score the next frame of the stream
+     *
+     * The frame is preprocessed as by MLP::preprocessImage, at the side of
+     * the model's square input; models taking other inputs are scored from
+     * preprocessed inputs only.
+     *
+     * @param frame Frame of any size
+     * @return Probability that the frame contains the target object, or 0 if the model's input is not square
+     */
+    float predict(const QImage& frame);
+
+    /**
+     * @brief Score the next preprocessed frame of the stream
+     * @param input Network input
+     * @return Probability that the frame contains the target object
+     */
+    float predict(const Eigen::VectorXf& input);
+
+    /**
+     * @brief Forget the previous frame, so the next one is computed in full
+     */
+    void reset();
+
+    /**
+     * @brief Get the number of pixels applied incrementally for the last frame
+     * @return Changed pixel count, or the whole input size after a full recompute
+     */
+    int getLastChangedCount() const { return lastChangedCount; }
+
+    /**
+     * @brief Whether the last frame was computed in full
+     * @return True after a full recompute
+     */
+    bool wasLastFull() const { return lastFull; }
+
+private:
+    const MLP& model;
+    StreamingOptions options;
+
+    // Input the pre-activations account for, and the first layer's pre-activations
+    Eigen::VectorXf reference;
+    Eigen::VectorXf firstZ;
+
+    // Scratch space reused by every frame
+    Eigen::VectorXf frameInput;
+    std::vector<Eigen::Index> changed;
+    Eigen::VectorXf changedDelta;
+    MLP::InferenceContext context;
+
+    bool hasReference;
+    int framesSinceRefresh;
+    int lastChangedCount;
+    bool lastFull;
+};
+
+#endif // STREAMINGPREDICTOR_H
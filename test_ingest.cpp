@@ -0,0 +1,72 @@
+#include "mlp.h"
+#include "datasetstore.h"
+#include <QCoreApplication>
+#include <QImageReader>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <sys/resource.h>
+
+// Peak resident set size of this process in MB
+static double peakRssMB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes on macOS
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes on Linux
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Peak RSS only ever grows, so each ingest strategy runs in its own process:
+    //   test_ingest <image dir>           streaming ingest into DatasetStore
+    //   test_ingest --legacy <image dir>  decode everything, then preprocess
+    QStringList args = app.arguments();
+    bool legacy = args.contains("--legacy");
+    args.removeAll("--legacy");
+    if (args.size() < 2) {
+        qDebug() << "Usage: test_ingest [--legacy] <image dir>";
+        return 1;
+    }
+
+    QStringList files = DatasetStore::imageFiles(args.at(1));
+
+    qDebug() << "Images found:" << files.size();
+    qDebug() << "Peak RSS before ingest:" << peakRssMB() << "MB";
+
+    QElapsedTimer timer;
+    timer.start();
+    size_t samples = 0;
+
+    if (legacy) {
+        // Previous TrainingWorker behaviour: every decoded QImage stays alive
+        // next to its float input vector
+        MLP mlp(512 * 512, 1, 1);
+        std::vector<QImage> images;
+        for (const QString& filePath : files) {
+            QImage image = QImageReader(filePath).read();
+            if (!image.isNull()) {
+                images.push_back(image);
+            }
+        }
+        std::vector<Eigen::VectorXf> inputs;
+        for (const auto& image : images) {
+            inputs.push_back(mlp.preprocessImage(image));
+        }
+        samples = inputs.size();
+    } else {
+        DatasetStore dataset;
+        dataset.reserve(files.size());
+        samples = dataset.appendImages(files, 1.0f);
+    }
+
+    qDebug() << "Mode:" << (legacy ? "legacy" : "streaming");
+    qDebug() << "Samples ingested:" << samples << "in" << timer.elapsed() << "ms";
+    qDebug() << "Peak RSS after ingest:" << peakRssMB() << "MB";
+
+    return 0;
+}
@@ -1,16 +1,50 @@
 #include "mlp.h"
+#include "streamingpredictor.h"
+#include "philox.h"
 #include <QCoreApplication>
 #include <QFile>
 #include <QFileInfo>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
 
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
     
-    // Create a test MLP with 512x512 input, 128 hidden neurons, and 1 output neuron
-    MLP mlp(512 * 512, 128, 1, "sigmoid", "sigmoid");
+    // Check the generator against the Philox4x32-10 known-answer vectors of
+    // Random123: key, counter (position, stream) and the expected output
+    struct PhiloxVector
+    {
+        std::uint64_t key;
+        std::uint64_t counter;
+        std::uint64_t stream;
+        std::uint32_t expected[4];
+    };
+    const PhiloxVector philoxVectors[] = {
+        {0, 0, 0, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+        {~0ull, ~0ull, ~0ull, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+        {0x299f31d0a4093822ull, 0x85a308d3243f6a88ull, 0x0370734413198a2eull,
+         {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+    };
+    for (const PhiloxVector& vector : philoxVectors) {
+        std::uint32_t output[4];
+        Philox4x32(vector.key).generate(vector.counter, vector.stream, output);
+        if (!std::equal(output, output + 4, vector.expected)) {
+            qDebug() << "Philox4x32 does not match its known-answer vectors";
+            return 1;
+        }
+    }
+    qDebug() << "Philox4x32 matches its known-answer vectors";
+    
+    // Create a test MLP with 512x512 input, 128 hidden neurons, and 1 output neuron;
+    // a fixed seed makes every run benchmark the same weights
+    QElapsedTimer initTimer;
+    initTimer.start();
+    MLP mlp(512 * 512, 128, 1, "sigmoid", "sigmoid", 1);
+    qDebug() << "Model initialized in" << initTimer.nsecsElapsed() / 1000000.0 << "ms";
     
     // Save in JSON format
     QString jsonPath = "test_model.json";
@@ -49,13 +83,174 @@ int main(int argc, char *argv[])
     qDebug() << "Size reduction:" << (1.0 - (double)binarySize / jsonSize) * 100.0 << "%";
     
     // Test loading the binary model
-    MLP loadedMlp(512 * 512, 128, 1);
-    if (loadedMlp.loadFromBinary(binaryPath)) {
+    std::unique_ptr<MLP> loadedMlp = MLP::fromFile(binaryPath);
+    if (loadedMlp) {
         qDebug() << "Successfully loaded model from binary format";
     } else {
         qDebug() << "Failed to load model from binary format";
         return 1;
     }
     
+    // Save in the aligned version 3 format and compare load times
+    QString alignedPath = "test_model_v3.senm";
+    MLP::BinaryOptions alignedOptions;
+    alignedOptions.formatVersion = 0x03;
+    if (!mlp.saveToBinary(alignedPath, alignedOptions)) {
+        qDebug() << "Failed to save model in aligned binary format";
+        return 1;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    std::unique_ptr<MLP> readMlp = MLP::fromFile(alignedPath);
+    if (!readMlp) {
+        qDebug() << "Failed to load model from aligned binary format";
+        return 1;
+    }
+    qDebug() << "Aligned binary read in" << timer.nsecsElapsed() / 1000000.0 << "ms";
+    
+    timer.restart();
+    std::unique_ptr<MLP> mappedMlp = MLP::fromFile(alignedPath, true);
+    if (!mappedMlp) {
+        qDebug() << "Failed to map model from aligned binary format";
+        return 1;
+    }
+    qDebug() << "Aligned binary mapped in" << timer.nsecsElapsed() / 1000000.0 << "ms";
+    
+    if (mappedMlp->getLayers()[0].getWeights() != mlp.getLayers()[0].getWeights()) {
+        qDebug() << "Mapped weights differ from the saved model";
+        return 1;
+    }
+    
+    // Save a compressed version 3 file and compare it with the raw version 2 file
+    QString compressedPath = "test_model_v3z.senm";
+    MLP::BinaryOptions compressedOptions;
+    compressedOptions.formatVersion = 0x03;
+    compressedOptions.compressionLevel = 6;
+    
+    timer.restart();
+    if (!mlp.saveToBinary(compressedPath, compressedOptions)) {
+        qDebug() << "Failed to save model in compressed binary format";
+        return 1;
+    }
+    qDebug() << "Compressed binary saved in" << timer.nsecsElapsed() / 1000000.0 << "ms";
+    
+    qint64 compressedSize = QFileInfo(compressedPath).size();
+    qDebug() << "Compressed binary file size:" << compressedSize << "bytes (" << compressedSize / (1024.0 * 1024.0) << "MB)";
+    qDebug() << "Compression ratio vs raw v2:" << (double)binarySize / compressedSize;
+    
+    // Throughput is measured against the size of the raw weights
+    timer.restart();
+    std::unique_ptr<MLP> rawMlp = MLP::fromFile(binaryPath);
+    if (!rawMlp) {
+        qDebug() << "Failed to load model from binary format";
+        return 1;
+    }
+    double rawMs = timer.nsecsElapsed() / 1000000.0;
+    qDebug() << "Raw v2 loaded in" << rawMs << "ms (" << binarySize / (1024.0 * 1024.0) / (rawMs / 1000.0) << "MB/s)";
+    
+    timer.restart();
+    std::unique_ptr<MLP> compressedMlp = MLP::fromFile(compressedPath);
+    if (!compressedMlp) {
+        qDebug() << "Failed to load model from compressed binary format";
+        return 1;
+    }
+    double compressedMs = timer.nsecsElapsed() / 1000000.0;
+    qDebug() << "Compressed v3 loaded in" << compressedMs << "ms (" << binarySize / (1024.0 * 1024.0) / (compressedMs / 1000.0) << "MB/s)";
+    
+    if (compressedMlp->getLayers()[0].getWeights() != mlp.getLayers()[0].getWeights()) {
+        qDebug() << "Decompressed weights differ from the saved model";
+        return 1;
+    }
+    
+    // Loading without checksums shows what verifying them costs
+    QString uncheckedPath = "test_model_v3_unchecked.senm";
+    MLP::BinaryOptions uncheckedOptions = alignedOptions;
+    uncheckedOptions.checksums = false;
+    if (!mlp.saveToBinary(uncheckedPath, uncheckedOptions)) {
+        qDebug() << "Failed to save model without checksums";
+        return 1;
+    }
+    timer.restart();
+    if (!MLP::fromFile(uncheckedPath)) {
+        qDebug() << "Failed to load model without checksums";
+        return 1;
+    }
+    qDebug() << "Aligned binary without checksums read in" << timer.nsecsElapsed() / 1000000.0 << "ms";
+    
+    // A single flipped bit in the weights must make the load fail
+    QFile corrupted(alignedPath);
+    if (!corrupted.open(QIODevice::ReadWrite) || !corrupted.seek(corrupted.size() - 4096)) {
+        qDebug() << "Failed to open the aligned binary file for corruption";
+        return 1;
+    }
+    QByteArray byte = corrupted.read(1);
+    byte[0] = static_cast<char>(byte[0] ^ 0x10);
+    corrupted.seek(corrupted.size() - 4096);
+    corrupted.write(byte);
+    corrupted.close();
+    
+    if (MLP::fromFile(alignedPath) || MLP::fromFile(alignedPath, true)) {
+        qDebug() << "Corrupted model file was not rejected";
+        return 1;
+    }
+    qDebug() << "Corrupted model file rejected";
+    
+    // Score a batch one input at a time and with one matrix product per layer
+    const int batchSize = 32;
+    Eigen::MatrixXf batch = (Eigen::MatrixXf::Random(512 * 512, batchSize).array() + 1.0f) * 0.5f;
+    MLP::InferenceContext context;
+    Eigen::VectorXf singleScores(batchSize);
+    
+    timer.restart();
+    for (int i = 0; i < batchSize; ++i) {
+        singleScores(i) = mlp.infer(batch.col(i), context)(0);
+    }
+    double singleMs = timer.nsecsElapsed() / 1000000.0;
+    
+    timer.restart();
+    Eigen::VectorXf batchScores = mlp.predictBatch(batch, context);
+    double batchMs = timer.nsecsElapsed() / 1000000.0;
+    
+    qDebug() << "Scored" << batchSize << "inputs in" << singleMs << "ms one at a time," << batchMs << "ms as a batch";
+    if ((singleScores - batchScores).cwiseAbs().maxCoeff() > 1e-4f) {
+        qDebug() << "Batched scores differ from single scores";
+        return 1;
+    }
+    
+    // Score frames that differ from the previous one in a small moving patch,
+    // in full and by updating the first layer for the changed pixels only
+    const int frameCount = 50;
+    Eigen::VectorXf frame = (Eigen::VectorXf::Random(512 * 512).array() + 1.0f) * 0.5f;
+    // No change threshold, so both must agree up to rounding
+    StreamingOptions streaming;
+    streaming.changeThreshold = 0.0f;
+    StreamingPredictor stream(mlp, streaming);
+    stream.predict(frame);
+    double fullMs = 0.0;
+    double streamMs = 0.0;
+    float streamError = 0.0f;
+    for (int f = 0; f < frameCount; ++f) {
+        for (int y = 0; y < 32; ++y) {
+            frame.segment((200 + y) * 512 + 4 * f, 32) = (Eigen::VectorXf::Random(32).array() + 1.0f) * 0.5f;
+        }
+    
+        timer.restart();
+        const float fullScore = mlp.infer(frame, context)(0);
+        fullMs += timer.nsecsElapsed() / 1000000.0;
+    
+        timer.restart();
+        const float streamScore = stream.predict(frame);
+        streamMs += timer.nsecsElapsed() / 1000000.0;
+        streamError = std::max(streamError, std::fabs(fullScore - streamScore));
+    }
+    
+    qDebug() << "Scored" << frameCount << "frames in" << fullMs << "ms in full," << streamMs << "ms incrementally";
+    qDebug() << "Per frame:" << fullMs / frameCount << "ms in full," << streamMs / frameCount << "ms incrementally";
+    if (streamError > 1e-4f) {
+        qDebug() << "Incremental scores differ from full scores by" << streamError;
+        return 1;
+    }
+    
     return 0;
 }
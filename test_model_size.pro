@@ -8,10 +8,18 @@ INCLUDEPATH += /usr/local/include/Eigen
 SOURCES += \
     test_model_size.cpp \
     mlp.cpp \
-    layer.cpp
+    streamingpredictor.cpp \
+    layer.cpp \
+    philox.cpp \
+    crc32c.cpp \
+    jsonstream.cpp
 
 HEADERS += \
     mlp.h \
-    layer.h
+    streamingpredictor.h \
+    layer.h \
+    philox.h \
+    crc32c.h \
+    jsonstream.h
 
 TARGET = test_model_size
@@ -0,0 +1,128 @@
+#include "thumbnailcache.h"
+#include "mlp.h"
+#include <QImageReader>
+#include <QDebug>
+
+ThumbnailCache::ThumbnailCache(qsizetype maxBytes, int inputWidth, int inputHeight)
+    : inputWidth(inputWidth), inputHeight(inputHeight), cache(maxBytes)
+{
+    // Two decoders keep up with stepping through images without competing
+    // with the training worker for every core
+    pool.setMaxThreadCount(2);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    {
+        QMutexLocker locker(&mutex);
+        wanted.clear();
+    }
+    pool.clear();
+    pool.waitForDone();
+}
+
+void ThumbnailCache::setDisplaySize(const QSize& size)
+{
+    QMutexLocker locker(&mutex);
+    if (size != displaySize) {
+        displaySize = size;
+        cache.clear();
+    }
+}
+
+bool ThumbnailCache::get(const QString& filePath, Entry& entry)
+{
+    QSize size;
+    {
+        QMutexLocker locker(&mutex);
+
+        // Wait for a prefetch of this file rather than decoding it twice
+        while (pending.contains(filePath)) {
+            decoded.wait(&mutex);
+        }
+
+        if (Entry* cached = cache.object(filePath)) {
+            entry = *cached;
+            return true;
+        }
+        size = displaySize;
+    }
+
+    if (!decode(filePath, size, entry)) {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    if (size == displaySize) {
+        insert(filePath, entry);
+    }
+    return true;
+}
+
+void ThumbnailCache::prefetch(const QStringList& filePaths)
+{
+    QMutexLocker locker(&mutex);
+
+    wanted = QSet<QString>(filePaths.begin(), filePaths.end());
+    for (const QString& filePath : filePaths) {
+        if (pending.contains(filePath) || cache.contains(filePath)) {
+            continue;
+        }
+        pending.insert(filePath);
+        pool.start([this, filePath]() { prefetchOne(filePath); });
+    }
+}
+
+void ThumbnailCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    cache.clear();
+}
+
+bool ThumbnailCache::decode(const QString& filePath, const QSize& size, Entry& entry) const
+{
+    QImageReader reader(filePath);
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "Failed to load image:" << filePath << reader.errorString();
+        return false;
+    }
+
+    // The full-resolution image is released as soon as both views exist
+    entry.originalSize = image.size();
+    entry.input = MLP::toInputImage(image, inputWidth, inputHeight);
+    entry.display = size.isEmpty() ? image : image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return true;
+}
+
+void ThumbnailCache::prefetchOne(const QString& filePath)
+{
+    QSize size;
+    {
+        QMutexLocker locker(&mutex);
+
+        // Skip files the viewer has moved away from since they were queued
+        if (!wanted.contains(filePath)) {
+            pending.remove(filePath);
+            decoded.wakeAll();
+            return;
+        }
+        size = displaySize;
+    }
+
+    Entry entry;
+    bool ok = decode(filePath, size, entry);
+
+    QMutexLocker locker(&mutex);
+    if (ok && size == displaySize) {
+        insert(filePath, entry);
+    }
+    pending.remove(filePath);
+    decoded.wakeAll();
+}
+
+void ThumbnailCache::insert(const QString& filePath, const Entry& entry)
+{
+    const qsizetype cost = qMax<qsizetype>(1, entry.display.sizeInBytes() + entry.input.sizeInBytes());
+    cache.insert(filePath, new Entry(entry), cost);
+}
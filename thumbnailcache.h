@@ -0,0 +1,102 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QSize>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/**
+ * @brief The ThumbnailCache class keeps recently viewed images ready for display
+ *
+ * Each file is decoded once into two small images: one scaled to fit the
+ * image view, and the grayscale network input. Entries are kept in an LRU
+ * cache bounded by their size in bytes. Images next to the current one are
+ * decoded on background threads, so stepping through a directory does not
+ * wait for the decoder.
+ */
+class ThumbnailCache
+{
+public:
+    /**
+     * @brief A decoded image
+     */
+    struct Entry
+    {
+        QImage display;      ///< Image scaled to fit the display size, keeping the aspect ratio
+        QImage input;        ///< Grayscale network input, as produced by MLP::toInputImage
+        QSize originalSize;  ///< Size of the image file
+    };
+
+    /**
+     * @brief ThumbnailCache constructor
+     * @param maxBytes Largest total size of the cached images
+     * @param inputWidth Width of the network input
+     * @param inputHeight Height of the network input
+     */
+    explicit ThumbnailCache(qsizetype maxBytes = 128 * 1024 * 1024, int inputWidth = 512, int inputHeight = 512);
+
+    /**
+     * @brief Cancel pending prefetches and wait for running ones
+     */
+    ~ThumbnailCache();
+
+    /**
+     * @brief Set the size images are scaled to for display
+     *
+     * Cached entries of a different display size are dropped.
+     *
+     * @param size Size of the image view
+     */
+    void setDisplaySize(const QSize& size);
+
+    /**
+     * @brief Get an image, decoding it if it is neither cached nor being prefetched
+     * @param filePath Image file
+     * @param entry Output entry
+     * @return True if successful, false if the file could not be decoded
+     */
+    bool get(const QString& filePath, Entry& entry);
+
+    /**
+     * @brief Decode images in the background
+     *
+     * Replaces any earlier prefetch request; queued files that are no longer
+     * requested are skipped.
+     *
+     * @param filePaths Files likely to be viewed next, most likely first
+     */
+    void prefetch(const QStringList& filePaths);
+
+    /**
+     * @brief Drop all cached images
+     */
+    void clear();
+
+private:
+    const int inputWidth;
+    const int inputHeight;
+
+    QCache<QString, Entry> cache;
+    QSize displaySize;
+    QSet<QString> pending;   // files queued or being decoded
+    QSet<QString> wanted;    // files of the latest prefetch request
+    QMutex mutex;
+    QWaitCondition decoded;
+    QThreadPool pool;
+
+    // Decode a file into an entry; safe to call from any thread
+    bool decode(const QString& filePath, const QSize& size, Entry& entry) const;
+
+    // Run a queued prefetch
+    void prefetchOne(const QString& filePath);
+
+    // Insert an entry; the mutex must be held
+    void insert(const QString& filePath, const Entry& entry);
+};
+
+#endif // THUMBNAILCACHE_H
@@ -1,17 +1,71 @@
 #include "trainingworker.h"
-#include <QDirIterator>
+#include "cascade.h"
 #include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSet>
 #include <QImageReader>
+#include <QThreadPool>
+#include <QJsonArray>
 #include <QDebug>
 #include <algorithm>
+#include <memory>
+#include <numeric>
 #include <random>
 
+namespace {
+
+// Samples scored together by evaluate()
+const size_t EVALUATION_BATCH = 32;
+
+// Version of the training state saved with checkpoints
+const int TRAINING_STATE_VERSION = 1;
+
+// Loss history as [[epoch, loss], ...]
+// Why the samples of a pack cannot go into a network taking inputSide x
+// inputSide images, or an empty string if they can
+QString packMismatch(const DatasetStore& pack, const QString& packFile, int inputSide)
+{
+    if (pack.getSampleWidth() == inputSide && pack.getSampleHeight() == inputSide) {
+        return QString();
+    }
+    return QString("The samples in %1 are %2x%3 pixels, but the network takes %4x%4")
+        .arg(packFile).arg(pack.getSampleWidth()).arg(pack.getSampleHeight()).arg(inputSide);
+}
+
+QJsonArray historyToJson(const QVector<QPointF>& history)
+{
+    QJsonArray json;
+    for (const QPointF& point : history) {
+        json.append(QJsonArray{point.x(), point.y()});
+    }
+    return json;
+}
+
+QVector<QPointF> historyFromJson(const QJsonArray& json)
+{
+    QVector<QPointF> history;
+    for (const QJsonValue& value : json) {
+        const QJsonArray point = value.toArray();
+        history.append(QPointF(point.at(0).toDouble(), point.at(1).toDouble()));
+    }
+    return history;
+}
+
+} // namespace
+
 TrainingWorker::TrainingWorker(MLP* mlp, QObject* parent)
-    : QObject(parent), mlp(mlp), learningRate(0.01f), epochs(100), batchSize(10), shuffle(true), stopRequested(false)
+    : QObject(parent), mlp(mlp), learningRate(0.01f), epochs(100), batchSize(10), shuffle(true), shuffleSeed(0), threadCount(0), stopRequested(false)
 {
     clearLossHistory();
 }
 
+void TrainingWorker::setMLP(MLP* mlp)
+{
+    QMutexLocker locker(&mutex);
+    this->mlp = mlp;
+}
+
 void TrainingWorker::setPositiveDir(const QString& dir)
 {
     QMutexLocker locker(&mutex);
@@ -24,6 +78,24 @@ void TrainingWorker::setNegativeDir(const QString& dir)
     negativeDir = dir;
 }
 
+void TrainingWorker::setPositiveFiles(const QStringList& filePaths)
+{
+    QMutexLocker locker(&mutex);
+    positiveFiles = filePaths;
+}
+
+void TrainingWorker::setNegativeFiles(const QStringList& filePaths)
+{
+    QMutexLocker locker(&mutex);
+    negativeFiles = filePaths;
+}
+
+void TrainingWorker::setPackFile(const QString& filePath)
+{
+    QMutexLocker locker(&mutex);
+    packFile = filePath;
+}
+
 void TrainingWorker::setLearningRate(float rate)
 {
     QMutexLocker locker(&mutex);
@@ -48,6 +120,42 @@ void TrainingWorker::setShuffle(bool shuffle)
     this->shuffle = shuffle;
 }
 
+void TrainingWorker::setShuffleSeed(quint64 seed)
+{
+    QMutexLocker locker(&mutex);
+    shuffleSeed = seed;
+}
+
+void TrainingWorker::setAugmentation(const AugmentationOptions& options)
+{
+    QMutexLocker locker(&mutex);
+    augmentation = options;
+}
+
+void TrainingWorker::setCheckpoint(const CheckpointOptions& options)
+{
+    QMutexLocker locker(&mutex);
+    checkpoint = options;
+}
+
+void TrainingWorker::setThreadCount(int count)
+{
+    QMutexLocker locker(&mutex);
+    threadCount = count;
+}
+
+void TrainingWorker::setResumeFile(const QString& filePath)
+{
+    QMutexLocker locker(&mutex);
+    resumeFile = filePath;
+}
+
+void TrainingWorker::setScreeningCascade(const QString& filePath)
+{
+    QMutexLocker locker(&mutex);
+    screeningCascade = filePath;
+}
+
 void TrainingWorker::stop()
 {
     QMutexLocker locker(&mutex);
@@ -77,35 +185,140 @@ void TrainingWorker::clearLossHistory()
     // Note: This method is already properly protected with a mutex lock
 }
 
-std::vector<QImage> TrainingWorker::loadImages(const QString& dir)
+void TrainingWorker::refreshDataset(const QString& positiveDir, const QString& negativeDir,
+                                    const QStringList& positiveFiles, const QStringList& negativeFiles,
+                                    int sampleSide)
 {
-    std::vector<QImage> images;
+    // A different pair of directories or sample size, or a dataset loaded
+    // from a pack, shares nothing with the current manifest
+    if (positiveDir != datasetPositiveDir || negativeDir != datasetNegativeDir ||
+        samplePaths.size() != dataset.size() ||
+        dataset.getSampleWidth() != sampleSide || dataset.getSampleHeight() != sampleSide) {
+        dataset.setSampleSize(sampleSide, sampleSide);
+        manifest.clear();
+        samplePaths.clear();
+        datasetPositiveDir = positiveDir;
+        datasetNegativeDir = negativeDir;
+    }
 
-    QDirIterator it(dir, QStringList() << "*.png" << "*.bmp", QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QString filePath = it.next();
-        QImageReader reader(filePath);
-        QImage image = reader.read();
+    const QStringList* files[] = { &positiveFiles, &negativeFiles };
 
-        if (!image.isNull()) {
-            images.push_back(image);
-        } else {
-            qWarning() << "Failed to load image:" << filePath << reader.errorString();
+    // Compare the directories against the manifest
+    QSet<QString> present;
+    QSet<QString> stale;
+    QStringList added[2];
+
+    for (int side = 0; side < 2; ++side) {
+        const float label = side == 0 ? 1.0f : 0.0f;
+        for (const QString& filePath : *files[side]) {
+            present.insert(filePath);
+
+            auto entry = manifest.find(filePath);
+            if (entry == manifest.end()) {
+                added[side].append(filePath);
+                continue;
+            }
+
+            QFileInfo info(filePath);
+            const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+            if (entry->label == label && entry->size == info.size() && entry->modified == modified) {
+                continue;
+            }
+
+            // Metadata changed; only re-ingest if the contents did too
+            if (entry->label == label && !entry->hash.isEmpty() &&
+                DatasetStore::fileHash(filePath) == entry->hash) {
+                entry->size = info.size();
+                entry->modified = modified;
+                continue;
+            }
+
+            stale.insert(filePath);
+            added[side].append(filePath);
+        }
+    }
+
+    for (auto it = manifest.cbegin(); it != manifest.cend(); ++it) {
+        if (!present.contains(it.key())) {
+            stale.insert(it.key());
         }
     }
 
-    return images;
+    // Drop removed and changed files
+    size_t removed = 0;
+    if (!stale.isEmpty()) {
+        std::vector<char> keep(samplePaths.size(), 1);
+        size_t kept = 0;
+        for (size_t i = 0; i < samplePaths.size(); ++i) {
+            if (stale.contains(samplePaths[i])) {
+                keep[i] = 0;
+                continue;
+            }
+            samplePaths[kept++] = samplePaths[i];
+        }
+        removed = samplePaths.size() - kept;
+        samplePaths.resize(kept);
+        dataset.retainSamples(keep);
+
+        for (const QString& filePath : stale) {
+            manifest.remove(filePath);
+        }
+    }
+
+    // Decode only the new and changed files
+    size_t appended = 0;
+    dataset.reserve(dataset.size() + added[0].size() + added[1].size());
+    for (int side = 0; side < 2; ++side) {
+        if (added[side].isEmpty()) {
+            continue;
+        }
+
+        // Stat before decoding so a file modified during ingest is picked up next time
+        std::vector<ManifestEntry> entries;
+        entries.reserve(added[side].size());
+        for (const QString& filePath : added[side]) {
+            QFileInfo info(filePath);
+            entries.push_back({ info.size(), info.lastModified().toMSecsSinceEpoch(), QByteArray(),
+                                side == 0 ? 1.0f : 0.0f });
+        }
+
+        std::vector<QByteArray> hashes;
+        appended += dataset.appendImages(added[side], side == 0 ? 1.0f : 0.0f, &hashes);
+
+        // Files that failed to decode stay in the manifest with an empty hash,
+        // so they are not retried until they change
+        for (qsizetype i = 0; i < added[side].size(); ++i) {
+            ManifestEntry& entry = entries[static_cast<size_t>(i)];
+            entry.hash = hashes[static_cast<size_t>(i)];
+            manifest.insert(added[side].at(i), entry);
+            if (!entry.hash.isEmpty()) {
+                samplePaths.push_back(added[side].at(i));
+            }
+        }
+    }
+
+    qDebug() << "Dataset refreshed:" << appended << "samples added," << removed << "removed,"
+             << dataset.size() << "total";
 }
 
 void TrainingWorker::train()
 {
     // Local variables to store thread-safe copies of the parameters
+    MLP* localMlp;
     QString localPositiveDir;
     QString localNegativeDir;
+    QStringList localPositiveFiles;
+    QStringList localNegativeFiles;
+    QString localPackFile;
     float localLearningRate;
     int localEpochs;
     int localBatchSize;
     bool localShuffle;
+    quint64 localShuffleSeed;
+    AugmentationOptions localAugmentation;
+    CheckpointOptions localCheckpoint;
+    QString localResumeFile;
+    int localThreadCount;
 
     // Get parameters under mutex lock
     {
@@ -115,89 +328,261 @@ void TrainingWorker::train()
         stopRequested = false;
 
         // Make local copies of all parameters
+        localMlp = mlp;
         localPositiveDir = positiveDir;
         localNegativeDir = negativeDir;
+        localPositiveFiles = positiveFiles;
+        localNegativeFiles = negativeFiles;
+        localPackFile = packFile;
         localLearningRate = learningRate;
         localEpochs = epochs;
         localBatchSize = batchSize;
         localShuffle = shuffle;
+        localShuffleSeed = shuffleSeed;
+        localAugmentation = augmentation;
+        localCheckpoint = checkpoint;
+        localResumeFile = resumeFile;
+        resumeFile.clear();
+        localThreadCount = threadCount;
 
         // Clear loss history at the start of training
         m_trainingLossHistory.clear();
         m_validationLossHistory.clear();
     }
 
-    // Load positive examples - done outside the mutex lock
-    std::vector<QImage> positiveImages = loadImages(localPositiveDir);
-    if (positiveImages.empty()) {
-        qWarning() << "No positive images found in" << localPositiveDir;
+    // Samples are stored at the resolution of the network input
+    const int inputSide = localMlp->getInputSide();
+    if (inputSide == 0) {
+        qWarning() << "The network input is not a square image";
+        emit trainingFailed("The network input is not a square image");
         emit trainingComplete(0.0f);
         return;
     }
 
-    // Prepare training data
-    std::vector<Eigen::VectorXf> inputs;
-    std::vector<Eigen::VectorXf> targets;
+    // Load examples - done outside the mutex lock
+    dataset.setThreadCount(localThreadCount);
+    if (!localPackFile.isEmpty()) {
+        // A packed dataset is mapped in one go
+        manifest.clear();
+        samplePaths.clear();
+        if (!dataset.loadPack(localPackFile) || dataset.isEmpty()) {
+            qWarning() << "Failed to load packed dataset" << localPackFile;
+            dataset.clear();
+            emit trainingFailed("Failed to load packed dataset " + localPackFile);
+            emit trainingComplete(0.0f);
+            return;
+        }
+        const QString mismatch = packMismatch(dataset, localPackFile, inputSide);
+        if (!mismatch.isEmpty()) {
+            qWarning() << mismatch;
+            dataset.clear();
+            emit trainingFailed(mismatch);
+            emit trainingComplete(0.0f);
+            return;
+        }
+    } else {
+        // Use the file lists from an earlier scan if there are any
+        if (localPositiveFiles.isEmpty()) {
+            localPositiveFiles = DatasetStore::imageFiles(localPositiveDir);
+        }
+        if (localNegativeFiles.isEmpty() && !localNegativeDir.isEmpty()) {
+            localNegativeFiles = DatasetStore::imageFiles(localNegativeDir);
+        }
 
-    // Process positive examples
-    for (const auto& image : positiveImages) {
-        inputs.push_back(mlp->preprocessImage(image));
-        targets.push_back(Eigen::VectorXf::Ones(1));
+        // Only images added or changed since the last run are decoded
+        refreshDataset(localPositiveDir, localNegativeDir, localPositiveFiles, localNegativeFiles, inputSide);
+
+        bool hasPositive = false;
+        for (size_t i = 0; i < dataset.size() && !hasPositive; ++i) {
+            hasPositive = dataset.label(i) >= 0.5f;
+        }
+        if (!hasPositive) {
+            qWarning() << "No positive images found in" << localPositiveDir;
+            emit trainingFailed("No positive images found in " + localPositiveDir);
+            emit trainingComplete(0.0f);
+            return;
+        }
     }
 
-    // Process negative examples if available
-    if (!localNegativeDir.isEmpty()) {
-        std::vector<QImage> negativeImages = loadImages(localNegativeDir);
-        for (const auto& image : negativeImages) {
-            inputs.push_back(mlp->preprocessImage(image));
-            targets.push_back(Eigen::VectorXf::Zero(1));
+    // Continue a checkpointed run: the weights, hyperparameters, shuffle
+    // seed and position within the run all come from the checkpoint
+    int firstEpoch = 0;
+    size_t firstPosition = 0;
+    float resumedLoss = 0.0f;
+    if (!localResumeFile.isEmpty()) {
+        MLP::ModelInfo info;
+        if (!MLP::inspectFile(localResumeFile, info) || info.trainingState.isEmpty() ||
+            !localMlp->loadFromBinary(localResumeFile)) {
+            qWarning() << "Failed to resume from checkpoint" << localResumeFile;
+            emit trainingFailed("Failed to resume from checkpoint " + localResumeFile);
+            emit trainingComplete(0.0f);
+            return;
+        }
+
+        const QJsonObject state = info.trainingState;
+        firstEpoch = state["epoch"].toInt();
+        firstPosition = static_cast<size_t>(state["position"].toInteger());
+        resumedLoss = static_cast<float>(state["epoch_loss"].toDouble());
+        localEpochs = state["epochs"].toInt();
+        localLearningRate = static_cast<float>(state["learning_rate"].toDouble());
+        localBatchSize = qMax(1, state["batch_size"].toInt());
+        localShuffle = state["shuffle"].toBool();
+        localShuffleSeed = state["shuffle_seed"].toString().toULongLong();
+
+        const QJsonObject augmentationState = state["augmentation"].toObject();
+        localAugmentation.enabled = augmentationState["enabled"].toBool();
+        localAugmentation.flipHorizontal = augmentationState["flip_horizontal"].toBool();
+        localAugmentation.flipVertical = augmentationState["flip_vertical"].toBool();
+        localAugmentation.maxRotation = static_cast<float>(augmentationState["max_rotation"].toDouble());
+        localAugmentation.maxTranslation = augmentationState["max_translation"].toInt();
+
+        // The visiting order depends on the number of samples; if the
+        // dataset changed, the interrupted epoch starts over
+        if (state["sample_count"].toInteger() != static_cast<qint64>(dataset.size()) ||
+            firstPosition > dataset.size()) {
+            qWarning() << "Dataset changed since the checkpoint; restarting epoch" << firstEpoch + 1;
+            firstPosition = 0;
+            resumedLoss = 0.0f;
         }
+
+        QVector<QPointF> trainingHistory = historyFromJson(state["training_loss_history"].toArray());
+        QVector<QPointF> validationHistory = historyFromJson(state["validation_loss_history"].toArray());
+        {
+            QMutexLocker locker(&mutex);
+            m_trainingLossHistory = trainingHistory;
+            m_validationLossHistory = validationHistory;
+        }
+
+        // Replay the history so the loss curve shows the whole run
+        for (const QPointF& point : trainingHistory) {
+            emit epochCompleted(static_cast<int>(point.x()), static_cast<float>(point.y()));
+        }
+    }
+
+    // Pick a seed for this run if none was given
+    if (localShuffleSeed == 0) {
+        std::random_device rd;
+        localShuffleSeed = (static_cast<quint64>(rd()) << 32) | rd();
+    }
+
+    // Visiting order; the samples themselves are never reordered
+    std::vector<int> order(dataset.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    // Rest of the order when an epoch is resumed part way through
+    std::vector<int> remainingOrder;
+
+    // Reused input and target buffers for the current sample
+    Eigen::VectorXf input;
+    Eigen::VectorXf target(1);
+
+    // Augmented inputs are produced on worker threads while this one trains
+    std::unique_ptr<AugmentationStage> augmentationStage;
+    if (localAugmentation.enabled) {
+        augmentationStage.reset(new AugmentationStage(dataset, localAugmentation, localShuffleSeed,
+                                                       localThreadCount));
+    }
+
+    // Everything needed to continue the run from a checkpoint taken after
+    // position samples of the zero-based epoch. The shuffle and augmentation
+    // are pure functions of the seed, the epoch and the sample, so the seed
+    // stands in for their generator state; plain SGD with a constant
+    // learning rate keeps no other state.
+    auto trainingState = [&](int epoch, size_t position, float epochLoss) {
+        QJsonObject augmentationState;
+        augmentationState["enabled"] = localAugmentation.enabled;
+        augmentationState["flip_horizontal"] = localAugmentation.flipHorizontal;
+        augmentationState["flip_vertical"] = localAugmentation.flipVertical;
+        augmentationState["max_rotation"] = localAugmentation.maxRotation;
+        augmentationState["max_translation"] = localAugmentation.maxTranslation;
+
+        QJsonObject state;
+        state["version"] = TRAINING_STATE_VERSION;
+        state["epoch"] = epoch;
+        state["position"] = static_cast<qint64>(position);
+        state["epoch_loss"] = epochLoss;
+        state["epochs"] = localEpochs;
+        state["learning_rate"] = localLearningRate;
+        state["learning_rate_schedule"] = "constant";
+        state["optimizer"] = "sgd";
+        state["optimizer_state"] = QJsonObject();
+        state["batch_size"] = localBatchSize;
+        state["shuffle"] = localShuffle;
+        state["shuffle_seed"] = QString::number(localShuffleSeed);
+        state["augmentation"] = augmentationState;
+        state["sample_count"] = static_cast<qint64>(dataset.size());
+
+        QMutexLocker locker(&mutex);
+        state["training_loss_history"] = historyToJson(m_trainingLossHistory);
+        state["validation_loss_history"] = historyToJson(m_validationLossHistory);
+        return state;
+    };
+
+    // Checkpoints are written on their own thread; training only pauses
+    // for the copy into the snapshot buffer. Any pending write finishes
+    // before this function returns.
+    std::unique_ptr<CheckpointWriter> checkpointWriter;
+    QElapsedTimer checkpointTimer;
+    if (!localCheckpoint.filePath.isEmpty()) {
+        checkpointWriter.reset(new CheckpointWriter(localCheckpoint.filePath));
+        checkpointTimer.start();
     }
+    auto saveCheckpoint = [&](int epoch, size_t position, float epochLoss) {
+        if (checkpointWriter) {
+            checkpointWriter->submit(*localMlp, trainingState(epoch, position, epochLoss));
+            checkpointTimer.restart();
+        }
+    };
+    auto checkpointDue = [&]() {
+        return checkpointWriter && localCheckpoint.intervalMinutes > 0 &&
+               checkpointTimer.elapsed() >= localCheckpoint.intervalMinutes * 60000LL;
+    };
 
     // Training loop
     float totalLoss = 0.0f;
 
-    for (int epoch = 0; epoch < localEpochs; ++epoch) {
+    for (int epoch = firstEpoch; epoch < localEpochs; ++epoch) {
+        // A resumed epoch continues where the checkpoint left it
+        const size_t start = epoch == firstEpoch ? firstPosition : 0;
+        totalLoss = epoch == firstEpoch ? resumedLoss : 0.0f;
+
         // Check if stop requested before each epoch
         {
             QMutexLocker locker(&mutex);
             if (stopRequested) {
-                emit trainingComplete(totalLoss / inputs.size());
+                locker.unlock();
+                saveCheckpoint(epoch, start, totalLoss);
+                emit trainingComplete(totalLoss / dataset.size());
                 return;
             }
         }
 
-        // Shuffle data if requested
+        // Shuffle the visiting order if requested
         if (localShuffle) {
-            std::random_device rd;
-            std::mt19937 g(rd());
-
-            std::vector<int> indices(inputs.size());
-            for (size_t i = 0; i < indices.size(); ++i) {
-                indices[i] = static_cast<int>(i);
-            }
-            std::shuffle(indices.begin(), indices.end(), g);
-
-            std::vector<Eigen::VectorXf> shuffledInputs;
-            std::vector<Eigen::VectorXf> shuffledTargets;
-
-            for (int idx : indices) {
-                shuffledInputs.push_back(inputs[idx]);
-                shuffledTargets.push_back(targets[idx]);
+            dataset.epochOrder(order, localShuffleSeed, epoch);
+        }
+        if (augmentationStage) {
+            if (start > 0) {
+                remainingOrder.assign(order.begin() + static_cast<std::ptrdiff_t>(start), order.end());
+                augmentationStage->startEpoch(remainingOrder, epoch);
+            } else {
+                augmentationStage->startEpoch(order, epoch);
             }
-
-            inputs = shuffledInputs;
-            targets = shuffledTargets;
         }
 
         // Train on batches
-        totalLoss = 0.0f;
-        for (size_t i = 0; i < inputs.size(); i += localBatchSize) {
-            size_t batchEnd = std::min(i + static_cast<size_t>(localBatchSize), inputs.size());
+        for (size_t i = start; i < order.size(); i += localBatchSize) {
+            size_t batchEnd = std::min(i + static_cast<size_t>(localBatchSize), order.size());
             float batchLoss = 0.0f;
 
             for (size_t j = i; j < batchEnd; ++j) {
-                batchLoss += mlp->train(inputs[j], targets[j], localLearningRate);
+                target(0) = dataset.label(order[j]);
+                if (augmentationStage) {
+                    batchLoss += localMlp->train(augmentationStage->next(), target, localLearningRate);
+                } else {
+                    dataset.copyInput(order[j], input);
+                    batchLoss += localMlp->train(input, target, localLearningRate);
+                }
             }
 
             totalLoss += batchLoss;
@@ -206,14 +591,21 @@ void TrainingWorker::train()
             {
                 QMutexLocker locker(&mutex);
                 if (stopRequested) {
-                    emit trainingComplete(totalLoss / inputs.size());
+                    locker.unlock();
+                    saveCheckpoint(epoch, batchEnd, totalLoss);
+                    emit trainingComplete(totalLoss / dataset.size());
                     return;
                 }
             }
+
+            // Long epochs are checkpointed by time as they go
+            if (checkpointDue()) {
+                saveCheckpoint(epoch, batchEnd, totalLoss);
+            }
         }
 
         // Calculate average loss
-        float avgLoss = totalLoss / inputs.size();
+        float avgLoss = totalLoss / dataset.size();
 
         // Store loss history - need to lock mutex for this
         {
@@ -221,13 +613,20 @@ void TrainingWorker::train()
             m_trainingLossHistory.append(QPointF(epoch + 1, avgLoss));
         }
 
+        // Save a checkpoint if one is due
+        if (checkpointWriter && localCheckpoint.intervalEpochs > 0 &&
+            (epoch + 1) % localCheckpoint.intervalEpochs == 0) {
+            saveCheckpoint(epoch + 1, 0, 0.0f);
+        }
+
         // Emit progress and epoch completion - done outside the mutex lock
         emit progressUpdated(epoch + 1, localEpochs, avgLoss);
         emit epochCompleted(epoch + 1, avgLoss);
     }
 
     // Training complete
-    emit trainingComplete(totalLoss / inputs.size());
+    saveCheckpoint(localEpochs, 0, 0.0f);
+    emit trainingComplete(totalLoss / dataset.size());
 }
 
 void TrainingWorker::evaluate()
@@ -235,60 +634,276 @@ void TrainingWorker::evaluate()
     // Local variables to store thread-safe copies of the parameters
     QString localPositiveDir;
     QString localNegativeDir;
+    QStringList localPositiveFiles;
+    QStringList localNegativeFiles;
+    QString localPackFile;
+    QString localScreeningCascade;
 
     // Get parameters under mutex lock
     {
         QMutexLocker locker(&mutex);
         localPositiveDir = positiveDir;
         localNegativeDir = negativeDir;
+        localPositiveFiles = positiveFiles;
+        localNegativeFiles = negativeFiles;
+        localPackFile = packFile;
+        localScreeningCascade = screeningCascade;
     }
 
-    // Load positive examples - done outside the mutex lock
-    std::vector<QImage> positiveImages = loadImages(localPositiveDir);
-    if (positiveImages.empty()) {
+    // A screening model, if set, decides the easy images on its own
+    std::unique_ptr<MLP> screenModel;
+    std::unique_ptr<Cascade> cascade;
+    if (!localScreeningCascade.isEmpty()) {
+        CascadeFile cascadeFile;
+        if (cascadeFile.read(localScreeningCascade)) {
+            screenModel = MLP::fromFile(cascadeFile.screenPath, true);
+        }
+        if (screenModel) {
+            cascade = std::make_unique<Cascade>(*screenModel, *mlp, cascadeFile.thresholds);
+        }
+        if (!cascade || !cascade->isValid()) {
+            qWarning() << "Failed to load screening cascade" << localScreeningCascade << "- evaluating without it";
+            cascade.reset();
+        }
+    }
+    Cascade::Context cascadeContext;
+    int escalated = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    // Evaluate straight from the packed records if a pack is set
+    if (!localPackFile.isEmpty()) {
+        DatasetStore packed;
+        if (!packed.loadPack(localPackFile) || packed.isEmpty()) {
+            qWarning() << "Failed to load packed dataset" << localPackFile;
+            emit evaluationFailed("Failed to load packed dataset " + localPackFile);
+            emit evaluationComplete(0.0f, 0, 0, 0, 0);
+            return;
+        }
+
+        // The records go into the network as they are, unless a cascade resamples them
+        const QString mismatch = cascade ? QString() : packMismatch(packed, localPackFile, mlp->getInputSide());
+        if (!mismatch.isEmpty()) {
+            qWarning() << mismatch;
+            emit evaluationFailed(mismatch);
+            emit evaluationComplete(0.0f, 0, 0, 0, 0);
+            return;
+        }
+
+        int truePositives = 0;
+        int trueNegatives = 0;
+        int falsePositives = 0;
+        int falseNegatives = 0;
+
+        // Score a batch of records at a time, one matrix product per layer
+        Eigen::VectorXf input;
+        Eigen::MatrixXf batch;
+        MLP::InferenceContext context;
+        for (size_t start = 0; start < packed.size(); start += EVALUATION_BATCH) {
+            const size_t count = std::min(packed.size() - start, EVALUATION_BATCH);
+            Eigen::VectorXf scores;
+            if (cascade) {
+                // The records are wrapped, not copied, for the cascade to resample
+                QList<QImage> images;
+                for (size_t j = 0; j < count; ++j) {
+                    images.append(QImage(packed.sampleData(start + j), packed.getSampleWidth(),
+                                         packed.getSampleHeight(), packed.getSampleWidth(),
+                                         QImage::Format_Grayscale8));
+                }
+                scores = cascade->predictBatch(images, cascadeContext);
+                escalated += static_cast<int>(cascadeContext.escalated.size());
+            } else {
+                batch.resize(static_cast<Eigen::Index>(packed.sampleSize()), static_cast<Eigen::Index>(count));
+                for (size_t j = 0; j < count; ++j) {
+                    packed.copyInput(start + j, input);
+                    batch.col(static_cast<Eigen::Index>(j)) = input;
+                }
+                scores = mlp->predictBatch(batch, context);
+            }
+
+            for (size_t j = 0; j < count; ++j) {
+                bool predictedPositive = scores(static_cast<Eigen::Index>(j)) >= 0.5f;
+                if (packed.label(start + j) >= 0.5f) {
+                    predictedPositive ? truePositives++ : falseNegatives++;
+                } else {
+                    predictedPositive ? falsePositives++ : trueNegatives++;
+                }
+            }
+        }
+
+        if (cascade) {
+            emit screeningComplete(escalated, static_cast<int>(packed.size()), timer.elapsed());
+        }
+        float accuracy = static_cast<float>(truePositives + trueNegatives) / packed.size();
+        emit evaluationComplete(accuracy, truePositives, trueNegatives, falsePositives, falseNegatives);
+        return;
+    }
+
+    // List examples unless an earlier scan already did - done outside the mutex lock
+    if (localPositiveFiles.isEmpty()) {
+        localPositiveFiles = DatasetStore::imageFiles(localPositiveDir);
+    }
+    if (localPositiveFiles.isEmpty()) {
         qWarning() << "No positive images found in" << localPositiveDir;
+        emit evaluationFailed("No positive images found in " + localPositiveDir);
         emit evaluationComplete(0.0f, 0, 0, 0, 0);
         return;
     }
 
-    // Load negative examples
-    std::vector<QImage> negativeImages = loadImages(localNegativeDir);
-    if (negativeImages.empty()) {
+    if (localNegativeFiles.isEmpty()) {
+        localNegativeFiles = DatasetStore::imageFiles(localNegativeDir);
+    }
+    if (localNegativeFiles.isEmpty()) {
         qWarning() << "No negative images found in" << localNegativeDir;
+        emit evaluationFailed("No negative images found in " + localNegativeDir);
         emit evaluationComplete(0.0f, 0, 0, 0, 0);
         return;
     }
 
-    // Evaluate on positive examples
+    // Positives first, then negatives
+    QStringList files = localPositiveFiles + localNegativeFiles;
+    const qsizetype positiveCount = localPositiveFiles.size();
+    const int inputSide = mlp->getInputSide();
+
     int truePositives = 0;
     int falseNegatives = 0;
+    int trueNegatives = 0;
+    int falsePositives = 0;
 
-    for (const auto& image : positiveImages) {
-        float prediction = mlp->predict(image);
-        if (prediction >= 0.5f) {
-            truePositives++;
+    // Decode a batch in parallel straight into the columns of the batch
+    // matrix, then score it with one matrix product per layer; a cascade
+    // resamples the decoded images itself
+    Eigen::MatrixXf batch;
+    MLP::InferenceContext context;
+    std::vector<QImage> images;
+    QThreadPool pool;
+    for (qsizetype start = 0; start < files.size(); start += static_cast<qsizetype>(EVALUATION_BATCH)) {
+        const qsizetype count = std::min(files.size() - start, static_cast<qsizetype>(EVALUATION_BATCH));
+        std::vector<char> decoded(static_cast<size_t>(count), 0);
+        if (cascade) {
+            images.assign(static_cast<size_t>(count), QImage());
         } else {
-            falseNegatives++;
+            batch.resize(inputSide * inputSide, count);
         }
-    }
 
-    // Evaluate on negative examples
-    int trueNegatives = 0;
-    int falsePositives = 0;
+        const bool keepImages = cascade != nullptr;
+        for (qsizetype j = 0; j < count; ++j) {
+            pool.start([&files, &batch, &images, &decoded, start, j, keepImages, inputSide]() {
+                const QString& filePath = files.at(start + j);
+                QImageReader reader(filePath);
+                QImage image = reader.read();
+                if (image.isNull()) {
+                    qWarning() << "Failed to load image:" << filePath << reader.errorString();
+                    return;
+                }
+                if (keepImages) {
+                    images[static_cast<size_t>(j)] = image;
+                } else {
+                    MLP::preprocessImage(image, batch.col(j), inputSide);
+                }
+                decoded[static_cast<size_t>(j)] = 1;
+            });
+        }
+        pool.waitForDone();
+
+        // Only the decoded images are scored; columns of images that failed to
+        // decode were never written, so the decoded ones are moved up front
+        std::vector<qsizetype> positions;
+        for (qsizetype j = 0; j < count; ++j) {
+            if (decoded[static_cast<size_t>(j)]) {
+                positions.push_back(j);
+            }
+        }
+        const Eigen::Index decodedCount = static_cast<Eigen::Index>(positions.size());
+        Eigen::VectorXf scores = Eigen::VectorXf::Zero(count);
+        if (decodedCount == 0) {
+            continue;
+        }
 
-    for (const auto& image : negativeImages) {
-        float prediction = mlp->predict(image);
-        if (prediction < 0.5f) {
-            trueNegatives++;
+        Eigen::VectorXf decodedScores;
+        if (cascade) {
+            QList<QImage> decodedImages;
+            for (qsizetype j : positions) {
+                decodedImages.append(images[static_cast<size_t>(j)]);
+            }
+            decodedScores = cascade->predictBatch(decodedImages, cascadeContext);
+            escalated += static_cast<int>(cascadeContext.escalated.size());
         } else {
-            falsePositives++;
+            for (Eigen::Index k = 0; k < decodedCount; ++k) {
+                if (positions[static_cast<size_t>(k)] != k) {
+                    batch.col(k) = batch.col(positions[static_cast<size_t>(k)]);
+                }
+            }
+            decodedScores = mlp->predictBatch(batch.leftCols(decodedCount), context);
+        }
+        for (Eigen::Index k = 0; k < decodedCount; ++k) {
+            scores(positions[static_cast<size_t>(k)]) = decodedScores(k);
+        }
+
+        for (qsizetype j = 0; j < count; ++j) {
+            if (!decoded[static_cast<size_t>(j)]) {
+                continue;
+            }
+            bool predictedPositive = scores(j) >= 0.5f;
+            if (start + j < positiveCount) {
+                predictedPositive ? truePositives++ : falseNegatives++;
+            } else {
+                predictedPositive ? falsePositives++ : trueNegatives++;
+            }
         }
     }
 
     // Calculate accuracy
-    int totalSamples = positiveImages.size() + negativeImages.size();
-    float accuracy = static_cast<float>(truePositives + trueNegatives) / totalSamples;
+    int totalSamples = truePositives + falseNegatives + trueNegatives + falsePositives;
+    float accuracy = totalSamples > 0 ? static_cast<float>(truePositives + trueNegatives) / totalSamples : 0.0f;
 
     // Emit evaluation results
+    if (cascade) {
+        emit screeningComplete(escalated, totalSamples, timer.elapsed());
+    }
     emit evaluationComplete(accuracy, truePositives, trueNegatives, falsePositives, falseNegatives);
 }
+
+void TrainingWorker::exportModel(const QString& filePath)
+{
+    MLP* localMlp;
+    {
+        QMutexLocker locker(&mutex);
+        localMlp = mlp;
+    }
+
+    // Runs on the worker thread, so training cannot modify the model while
+    // it is being written
+    bool success = filePath.endsWith(".senm", Qt::CaseInsensitive)
+                       ? localMlp->saveToBinary(filePath)
+                       : localMlp->saveToJsonFile(filePath);
+    if (!success) {
+        qWarning() << "Failed to export model:" << filePath;
+    }
+
+    emit modelExported(filePath, success);
+}
+
+void TrainingWorker::importModel(const QString& filePath)
+{
+    int inputSize;
+    int outputSize;
+    {
+        QMutexLocker locker(&mutex);
+        inputSize = mlp->getLayers().front().getInputSize();
+        outputSize = mlp->getLayers().back().getOutputSize();
+    }
+
+    // The model takes its architecture from the file, but has to fit the
+    // inputs and outputs the rest of the application works with
+    std::unique_ptr<MLP> model = MLP::fromFile(filePath);
+    if (model && (model->getLayers().front().getInputSize() != inputSize ||
+                  model->getLayers().back().getOutputSize() != outputSize)) {
+        qWarning() << "Model does not match the network's input and output sizes:" << filePath;
+        model.reset();
+    } else if (!model) {
+        qWarning() << "Failed to import model:" << filePath;
+    }
+
+    emit modelImported(filePath, std::shared_ptr<MLP>(std::move(model)));
+}
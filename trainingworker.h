@@ -2,12 +2,16 @@
 #define TRAININGWORKER_H
 
 #include "mlp.h"
+#include "datasetstore.h"
+#include "augmentationstage.h"
+#include "checkpointwriter.h"
 #include <QObject>
 #include <QThread>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QDir>
 #include <QImage>
+#include <QHash>
 #include <vector>
 
 /**
@@ -25,6 +29,16 @@ public:
      */
     explicit TrainingWorker(MLP* mlp, QObject* parent = nullptr);
 
+    /**
+     * @brief Set the MLP to train
+     *
+     * The ingested dataset is kept, so retraining a new model on the same
+     * directories only processes the files that changed.
+     *
+     * @param mlp Pointer to the MLP to train
+     */
+    void setMLP(MLP* mlp);
+
     /**
      * @brief Set the positive examples directory
      * @param dir Directory containing positive examples
@@ -37,6 +51,24 @@ public:
      */
     void setNegativeDir(const QString& dir);
 
+    /**
+     * @brief Set the positive example files found by a scan of the positive directory
+     * @param filePaths Image files, or an empty list to scan the directory when needed
+     */
+    void setPositiveFiles(const QStringList& filePaths);
+
+    /**
+     * @brief Set the negative example files found by a scan of the negative directory
+     * @param filePaths Image files, or an empty list to scan the directory when needed
+     */
+    void setNegativeFiles(const QStringList& filePaths);
+
+    /**
+     * @brief Set a packed dataset file to use instead of the example directories
+     * @param filePath Path of a .senp file built by sensuser-pack, or empty to use the directories
+     */
+    void setPackFile(const QString& filePath);
+
     /**
      * @brief Set the learning rate
      * @param rate Learning rate
@@ -61,6 +93,51 @@ public:
      */
     void setShuffle(bool shuffle);
 
+    /**
+     * @brief Set the seed used to shuffle the data
+     * @param seed Shuffle seed, or 0 to pick a random seed for each run
+     */
+    void setShuffleSeed(quint64 seed);
+
+    /**
+     * @brief Set the data augmentation applied during training
+     * @param options Augmentation options; augmentation is off unless options.enabled is set
+     */
+    void setAugmentation(const AugmentationOptions& options);
+
+    /**
+     * @brief Set when to save checkpoints during training
+     * @param options Checkpoint file and intervals
+     */
+    void setCheckpoint(const CheckpointOptions& options);
+
+    /**
+     * @brief Set the number of threads used to decode and augment images
+     * @param count Number of threads, or 0 to pick one per core
+     */
+    void setThreadCount(int count);
+
+    /**
+     * @brief Continue the next training run from a checkpoint
+     *
+     * The checkpoint's weights replace those of the model, and its training
+     * state replaces the hyperparameters and loss history set on the worker.
+     * Applies to the next call to train() only.
+     *
+     * @param filePath Checkpoint written during an earlier run, or empty to start afresh
+     */
+    void setResumeFile(const QString& filePath);
+
+    /**
+     * @brief Screen images with a small model before the model being trained during evaluation
+     *
+     * Only the cascade file's screening model and thresholds are used; the
+     * model being trained takes the place of its full model.
+     *
+     * @param filePath Cascade file written by sensuser-cascade, or empty to evaluate with the model alone
+     */
+    void setScreeningCascade(const QString& filePath);
+
     /**
      * @brief Stop training
      */
@@ -94,6 +171,25 @@ public slots:
      */
     void evaluate();
 
+    /**
+     * @brief Write the model to a file
+     *
+     * The format follows the extension: .senm for binary, JSON otherwise.
+     *
+     * @param filePath Path to write the model to
+     */
+    void exportModel(const QString& filePath);
+
+    /**
+     * @brief Load a model from a file into a new MLP
+     *
+     * The model being trained is left untouched; the receiver of
+     * modelImported decides whether to switch to the new one.
+     *
+     * @param filePath Path of a .senm or JSON model file
+     */
+    void importModel(const QString& filePath);
+
 signals:
     /**
      * @brief Signal emitted when training progress is updated
@@ -117,6 +213,12 @@ signals:
      */
     void trainingComplete(float finalLoss);
 
+    /**
+     * @brief Signal emitted when training could not start, just before trainingComplete
+     * @param reason Description of the problem
+     */
+    void trainingFailed(const QString& reason);
+
     /**
      * @brief Signal emitted when evaluation is complete
      * @param accuracy Accuracy of the model
@@ -127,28 +229,94 @@ signals:
      */
     void evaluationComplete(float accuracy, int truePositives, int trueNegatives, int falsePositives, int falseNegatives);
 
+    /**
+     * @brief Signal emitted when evaluation could not run, just before evaluationComplete
+     * @param reason Description of the problem
+     */
+    void evaluationFailed(const QString& reason);
+
+    /**
+     * @brief Signal emitted before evaluationComplete when a screening cascade was used
+     * @param escalated Number of images the screening model left to the full model
+     * @param scored Number of images scored
+     * @param milliseconds Time spent scoring, decoding included
+     */
+    void screeningComplete(int escalated, int scored, qint64 milliseconds);
+
+    /**
+     * @brief Signal emitted when an export has finished
+     * @param filePath Path the model was written to
+     * @param success Whether the file was written
+     */
+    void modelExported(const QString& filePath, bool success);
+
+    /**
+     * @brief Signal emitted when an import has finished
+     * @param filePath Path the model was read from
+     * @param model Loaded model, or nullptr on failure; freed with the last
+     *        copy of the signal if no receiver keeps it
+     */
+    void modelImported(const QString& filePath, std::shared_ptr<MLP> model);
+
 private:
+    /**
+     * @brief What is known about an ingested file
+     */
+    struct ManifestEntry
+    {
+        qint64 size;            ///< File size in bytes when ingested
+        qint64 modified;        ///< Modification time in ms since the epoch when ingested
+        QByteArray hash;        ///< Content hash, empty if the file failed to decode
+        float label;            ///< Target value of the file
+    };
+
+    /**
+     * @brief Bring the dataset up to date with the example directories
+     *
+     * Files are matched against the manifest by size and modification time;
+     * files whose metadata changed are hashed, and only files that are new or
+     * whose contents changed are decoded. Removed files are dropped from the
+     * dataset.
+     *
+     * @param positiveDir Directory containing positive examples
+     * @param negativeDir Directory containing negative examples
+     * @param positiveFiles Image files in positiveDir
+     * @param negativeFiles Image files in negativeDir
+     * @param sampleSide Side length of the samples, that of the network input
+     */
+    void refreshDataset(const QString& positiveDir, const QString& negativeDir,
+                        const QStringList& positiveFiles, const QStringList& negativeFiles, int sampleSide);
+
     MLP* mlp;
     QString positiveDir;
     QString negativeDir;
+    QStringList positiveFiles;
+    QStringList negativeFiles;
+    QString packFile;
     float learningRate;
     int epochs;
     int batchSize;
     bool shuffle;
+    quint64 shuffleSeed;
+    AugmentationOptions augmentation;
+    CheckpointOptions checkpoint;
+    QString resumeFile;
+    QString screeningCascade;
+    int threadCount;
     bool stopRequested;
 
+    // Ingested samples, kept between runs; only touched by the worker thread
+    DatasetStore dataset;
+    QString datasetPositiveDir;
+    QString datasetNegativeDir;
+    QHash<QString, ManifestEntry> manifest;
+    std::vector<QString> samplePaths;   // source file of each sample in dataset
+
     QVector<QPointF> m_trainingLossHistory;
     QVector<QPointF> m_validationLossHistory;
 
     QMutex mutex;
     QWaitCondition condition;
-
-    /**
-     * @brief Load images from a directory
-     * @param dir Directory to load images from
-     * @return Vector of loaded images
-     */
-    std::vector<QImage> loadImages(const QString& dir);
 };
 
 #endif // TRAININGWORKER_H